@@ -0,0 +1,222 @@
+"""
+Server-side alert rules, evaluated on every ingested sample of every sensor.
+
+Rule kinds and their params:
+  threshold   {"level": float, "direction": "above" | "below"}
+  hysteresis  {"raise": float, "clear": float}   raise above `raise`, clear below `clear`
+              (or the mirror image when raise < clear)
+  rate        {"limit": float}                   |d torque / dt| in N·cm per second
+  duration    {"level": float, "direction": ..., "hold_ms": int}
+              threshold that must hold for hold_ms before it raises
+
+Every rule compiles to the same row of numbers (signal, sign, on level, off
+level, hold time), so one sensor's rules are evaluated together as numpy
+arrays over each ingested batch. Each raise / clear edge becomes an event in
+torque_store's alert_events table, stamped with the sample's epoch µs.
+"""
+
+import threading
+
+import numpy as np
+
+import torque_store
+
+RULE_KINDS = ("threshold", "hysteresis", "rate", "duration")
+
+
+class RuleError(ValueError):
+    pass
+
+
+def compile_rule(kind, params):
+    """Return (use_rate, sign, on_level, off_level, hold_us) for one rule."""
+    try:
+        if kind in ("threshold", "duration"):
+            sign = _direction(params.get("direction", "above"))
+            level = float(params["level"])
+            hold_us = int(params.get("hold_ms", 0)) * 1000 if kind == "duration" else 0
+            if hold_us < 0:
+                raise RuleError("hold_ms must not be negative")
+            return False, sign, level, level, hold_us
+        if kind == "hysteresis":
+            on, off = float(params["raise"]), float(params["clear"])
+            return False, 1.0 if on >= off else -1.0, on, off, 0
+        if kind == "rate":
+            limit = float(params["limit"])
+            return True, 1.0, limit, limit, 0
+    except (KeyError, TypeError, ValueError) as e:
+        if isinstance(e, RuleError):
+            raise
+        raise RuleError(f"Invalid params for {kind} rule: {str(e)}")
+    raise RuleError(f"Unknown rule kind: {kind}")
+
+
+def _direction(value):
+    if value not in ("above", "below"):
+        raise RuleError(f"direction must be 'above' or 'below', not {value!r}")
+    return 1.0 if value == "above" else -1.0
+
+
+class CompiledRules:
+    """All rules that apply to one sensor, plus the state they carry between batches."""
+
+    def __init__(self, rules):
+        self.ids = [r["id"] for r in rules]
+        self.names = [r["name"] for r in rules]
+        self.definitions = [(r["kind"], r["params"], r["sensor_id"]) for r in rules]
+        compiled = [compile_rule(r["kind"], r["params"]) for r in rules]
+        use_rate, sign, on, off, hold = zip(*compiled) if compiled else ((),) * 5
+        self.use_rate = np.array(use_rate, dtype=bool)
+        self.sign = np.array(sign, dtype=np.float64)[:, None]
+        self.on = np.array(on, dtype=np.float64)[:, None]
+        self.off = np.array(off, dtype=np.float64)[:, None]
+        self.hold = np.array(hold, dtype=np.int64)[:, None]
+
+        n = len(rules)
+        self.state = np.zeros(n, dtype=bool)         # level / hysteresis state
+        self.run_start = np.zeros(n, dtype=np.int64)  # when state last turned on
+        self.alerting = np.zeros(n, dtype=bool)       # state after the hold time
+        self.last_ts = None
+        self.last_value = None
+
+    def carry_over(self, old):
+        """
+        Take the state of every rule whose id and definition are unchanged
+        from old. Returns the indices into old of rules that were raised and
+        are now edited or gone, so their alerts can be cleared.
+        """
+        self.last_ts, self.last_value = old.last_ts, old.last_value
+        current = {rule_id: i for i, rule_id in enumerate(self.ids)}
+        dropped = []
+        for j, rule_id in enumerate(old.ids):
+            i = current.get(rule_id)
+            if i is not None and old.definitions[j] == self.definitions[i]:
+                self.state[i] = old.state[j]
+                self.run_start[i] = old.run_start[j]
+                self.alerting[i] = old.alerting[j]
+            elif old.alerting[j]:
+                dropped.append(j)
+        return dropped
+
+    def evaluate(self, ts_us, values):
+        """
+        Run one batch of samples through every rule.
+        Returns [(ts_us, rule_index, "raised" | "cleared", value), ...] in time order.
+        """
+        if not self.ids or not len(values):
+            return []
+        ts_us = np.asarray(ts_us, dtype=np.int64)
+        values = np.asarray(values, dtype=np.float64)
+
+        # Rate between consecutive samples; samples sharing a timestamp have none (NaN)
+        prev_ts = np.concatenate([[self.last_ts if self.last_ts is not None else ts_us[0]], ts_us[:-1]])
+        prev_v = np.concatenate([[self.last_value if self.last_value is not None else values[0]], values[:-1]])
+        dt = (ts_us - prev_ts) / 1e6
+        with np.errstate(divide="ignore", invalid="ignore"):
+            rate = np.where(dt > 0, np.abs(values - prev_v) / dt, np.nan)
+        signal = np.where(self.use_rate[:, None], rate[None, :], values[None, :])
+
+        # Hysteresis: each sample either turns the state on, off, or leaves it;
+        # forward-fill the last decision, seeded with the carried state
+        s = self.sign * signal
+        decision = np.where(s > self.sign * self.on, 1, np.where(s <= self.sign * self.off, 0, -1))
+        state = forward_fill(decision, self.state.astype(np.int64)).astype(bool)
+
+        # Duration: state must have been on since at least hold_us ago
+        prev_state = np.concatenate([self.state[:, None], state[:, :-1]], axis=1)
+        turned_on = state & ~prev_state
+        idx = np.where(turned_on, np.arange(len(ts_us))[None, :], -1)
+        start_idx = np.maximum.accumulate(idx, axis=1)
+        run_start = np.where(start_idx >= 0, ts_us[np.maximum(start_idx, 0)], self.run_start[:, None])
+        alerting = state & (ts_us[None, :] - run_start >= self.hold)
+
+        prev_alerting = np.concatenate([self.alerting[:, None], alerting[:, :-1]], axis=1)
+        raised = alerting & ~prev_alerting
+        cleared = ~alerting & prev_alerting
+
+        self.state = state[:, -1]
+        self.run_start = run_start[:, -1]
+        self.alerting = alerting[:, -1]
+        self.last_ts = int(ts_us[-1])
+        self.last_value = float(values[-1])
+
+        events = []
+        for edges, label in ((raised, "raised"), (cleared, "cleared")):
+            rule_idx, sample_idx = np.nonzero(edges)
+            events.extend(
+                (int(ts_us[j]), int(i), label, float(values[j]))
+                for i, j in zip(rule_idx.tolist(), sample_idx.tolist())
+            )
+        events.sort(key=lambda e: e[0])
+        return events
+
+
+def forward_fill(decision, initial):
+    """Replace -1 entries of each row with the last non -1 value to their left (or initial)."""
+    cols = np.arange(decision.shape[1])[None, :]
+    last = np.maximum.accumulate(np.where(decision >= 0, cols, -1), axis=1)
+    filled = np.take_along_axis(decision, np.maximum(last, 0), axis=1)
+    return np.where(last >= 0, filled, initial[:, None])
+
+
+class AlertEngine:
+    """
+    Holds the enabled rules compiled per sensor, evaluates ingested batches
+    and wakes up anyone waiting for new events.
+    """
+
+    def __init__(self):
+        self._rules = []
+        self._compiled = {}  # sensor_id -> CompiledRules
+        self._lock = threading.Lock()
+        self._new_events = threading.Condition()
+        self.last_seq = 0
+
+    def reload(self):
+        """
+        Re-read the rules from the store; call after any rule change. Rules
+        that did not change keep their raised state, so an edit elsewhere
+        does not raise an active alert a second time.
+        """
+        rules = torque_store.list_alert_rules(enabled_only=True)
+        now = torque_store.now_us()
+        rows = []
+        with self._lock:
+            self._rules = rules
+            previous, self._compiled = self._compiled, {}
+            for sensor_id, old in previous.items():
+                compiled = self._compiled[sensor_id] = self._compile(sensor_id)
+                # Raised alerts of edited or removed rules are closed here; an
+                # edited rule then starts over and raises again if it still applies
+                rows.extend((now, sensor_id, old.ids[j], old.names[j], "cleared", old.last_value)
+                            for j in compiled.carry_over(old))
+        if rows:
+            torque_store.save_alert_events(rows)
+        with self._new_events:
+            self.last_seq = torque_store.last_alert_seq()
+            self._new_events.notify_all()
+
+    def evaluate(self, sensor_id, ts_us, values):
+        """Evaluate one sensor's samples (epoch µs, torque) and store any events."""
+        with self._lock:
+            compiled = self._compiled.get(sensor_id)
+            if compiled is None:
+                compiled = self._compiled[sensor_id] = self._compile(sensor_id)
+            events = compiled.evaluate(ts_us, values)
+            rows = [(ts, sensor_id, compiled.ids[i], compiled.names[i], label, value)
+                    for ts, i, label, value in events]
+        if rows:
+            seq = torque_store.save_alert_events(rows)
+            with self._new_events:
+                self.last_seq = seq
+                self._new_events.notify_all()
+        return len(rows)
+
+    def _compile(self, sensor_id):
+        return CompiledRules([r for r in self._rules
+                              if r["sensor_id"] in (sensor_id, torque_store.ALL_SENSORS)])
+
+    def wait(self, after_seq, timeout):
+        """Block until an event newer than after_seq exists or timeout passes."""
+        with self._new_events:
+            return self._new_events.wait_for(lambda: self.last_seq > after_seq, timeout)
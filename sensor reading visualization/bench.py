@@ -0,0 +1,353 @@
+"""
+Benchmarks for the decode, storage and query hot paths.
+
+Each benchmark runs against a synthetic dataset of N samples (4 sensors at
+1 kHz, tightening cycles plus noise from loadgen.SimSensor), built once
+through torque_store.save_batch() and cached under --data-dir. Results are
+JSON lines, one per (benchmark, N), so runs can be diffed or kept as a
+baseline; --compare exits non-zero when a benchmark got slower than the
+baseline by more than --tolerance.
+
+    python bench.py                                       # 1e4 and 1e5 samples
+    python bench.py --sizes 1e4 1e6 1e8 --out results.jsonl
+    python bench.py --only decode_frames latest --compare baseline.jsonl --tolerance 0.25
+
+Benchmarks that touch stored rows (inserts, range scan, resample, CSV
+export) are capped at a fixed number of rows, so their time stays flat as
+N grows; the aggregate queries read the rollups, one row per sensor and
+minute (60,000 samples at 1 kHz). In-memory ones
+(decode, calibrate) work through all N samples in fixed-size blocks: memory
+stays flat, but their time grows linearly with N, as does building and
+caching the dataset.
+"""
+
+import argparse
+import io
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+import numpy as np
+
+import decoder
+import exporters
+import resample
+import torque_store
+from loadgen import SimSensor
+
+SENSORS = 4
+RATE_HZ = 1000.0
+START_US = 1_700_000_000_000_000  # fixed epoch, so datasets are reproducible
+BUILD_BATCH = 100_000             # rows per save_batch while building a dataset
+BLOCK = 1 << 20                   # samples per block for in-memory benchmarks
+FRAME_SAMPLES = 20                # samples per notification frame
+FRAMES_PER_BATCH = 1000           # frames per writer batch, as in ingest
+OFFSET, SCALE = 0.0, 0.001
+
+BENCHMARKS = {}
+
+
+def benchmark(name, unit="samples", cap=None):
+    """Register fn(dataset) -> items processed; cap limits items for slow paths."""
+    def register(fn):
+        BENCHMARKS[name] = (fn, unit, cap)
+        return fn
+    return register
+
+
+class Dataset:
+    """A cached synthetic database of n samples, plus a block of packed frames."""
+
+    def __init__(self, n, data_dir):
+        self.n = int(n)
+        self.path = os.path.join(data_dir, f"bench_{self.n}.db")
+        self.build_s = None
+        if not _complete(self.path, self.n):
+            self.build_s = self._build()
+        else:
+            # A cached dataset may predate tables added since; init_db adds them
+            torque_store.init_db(self.path, offset=OFFSET, scale=SCALE)
+        self.end_us = START_US + int((self.n // SENSORS) * 1e6 / RATE_HZ)
+
+        sim = SimSensor("bench", RATE_HZ, OFFSET, SCALE, seed=0)
+        self.block = sim.counts(min(BLOCK, self.n))
+        frames = self.block[:len(self.block) // FRAME_SAMPLES * FRAME_SAMPLES]
+        packed = frames.astype("<i4").view(np.uint8).reshape(-1, 4)[:, :3].tobytes()
+        size = FRAME_SAMPLES * 3
+        self.frames = [packed[i:i + size] for i in range(0, len(packed), size)]
+
+    def _build(self):
+        for suffix in ("", "-wal", "-shm"):
+            if os.path.exists(self.path + suffix):
+                os.remove(self.path + suffix)
+        torque_store.init_db(self.path, offset=OFFSET, scale=SCALE)
+        torque_store.DB_FILE = self.path
+        sims = [SimSensor(f"sensor-{i}", RATE_HZ, OFFSET, SCALE, seed=i) for i in range(SENSORS)]
+        names = np.array([s.sensor_id for s in sims], dtype=object)
+        began = time.perf_counter()
+        done = 0
+        while done < self.n:
+            rows = min(BUILD_BATCH, self.n - done)
+            per_sensor = -(-rows // SENSORS)
+            counts = np.stack([s.counts(per_sensor) for s in sims], axis=1).ravel()[:rows]
+            idx = done + np.arange(rows)
+            ts = START_US + (idx // SENSORS) * int(1e6 / RATE_HZ)
+            torque_store.save_batch(list(zip(ts.tolist(), counts.tolist(), names[idx % SENSORS].tolist())))
+            done += rows
+        return time.perf_counter() - began
+
+
+def _complete(path, n):
+    if not os.path.exists(path):
+        return False
+    try:
+        conn = torque_store.connect(path)
+        row = conn.execute("SELECT max(id) FROM torque_data").fetchone()
+        conn.close()
+    except Exception:
+        return False
+    return row is not None and row[0] == n
+
+
+# ── Decode and calibration ──
+
+@benchmark("decode_frames")
+def bench_decode_frames(ds):
+    """Batched numpy decode of 20-sample frames, FRAMES_PER_BATCH frames per call."""
+    batches = [ds.frames[i:i + FRAMES_PER_BATCH] for i in range(0, len(ds.frames), FRAMES_PER_BATCH)]
+    per_pass = len(ds.frames) * FRAME_SAMPLES
+    done = 0
+    while done < ds.n:
+        for batch in batches:
+            decoder.unpack_frames(batch)
+        done += per_pass
+    return done
+
+
+@benchmark("decode_scalar", cap=200_000)
+def bench_decode_scalar(ds, limit):
+    """int.from_bytes per sample, as the old per-notification handler did (reference)."""
+    data = b"".join(ds.frames)
+    n = min(limit, len(data) // 3)
+    for i in range(n):
+        int.from_bytes(data[i * 3:i * 3 + 3], "little", signed=True)
+    return n
+
+
+@benchmark("calibrate")
+def bench_calibrate(ds):
+    """Calibration.apply(): per-sample version lookup plus (raw - offset) * scale."""
+    calibration = torque_store.load_calibration()
+    sensors = np.array([f"sensor-{i % SENSORS}" for i in range(len(ds.block))], dtype=object)
+    ts = START_US + np.arange(len(ds.block), dtype=np.int64) * 250
+    done = 0
+    while done < ds.n:
+        calibration.apply(sensors, ts, ds.block)
+        done += len(ds.block)
+    return done
+
+
+# ── Inserts (scratch database beside the dataset) ──
+
+def _scratch(ds):
+    path = ds.path + ".scratch"
+    for suffix in ("", "-wal", "-shm"):
+        if os.path.exists(path + suffix):
+            os.remove(path + suffix)
+    torque_store.init_db(path, offset=OFFSET, scale=SCALE)
+    return path
+
+
+@benchmark("insert_single", unit="rows", cap=2_000)
+def bench_insert_single(ds, limit):
+    """save_val(): one transaction per sample."""
+    torque_store.DB_FILE = _scratch(ds)
+    n = min(limit, ds.n)
+    for i, raw in enumerate(ds.block[:n].tolist()):
+        torque_store.save_val(raw, "sensor-0", START_US + i * 1000)
+    return n
+
+
+@benchmark("insert_batch", unit="rows", cap=1_000_000)
+def bench_insert_batch(ds, limit):
+    """save_batch() with 1000-row transactions, as the ingest writer commits."""
+    torque_store.DB_FILE = _scratch(ds)
+    n = min(limit, ds.n)
+    raw = np.resize(ds.block, n).tolist()
+    for start in range(0, n, 1000):
+        torque_store.save_batch([(START_US + i * 1000, raw[i], "sensor-0")
+                                 for i in range(start, min(start + 1000, n))])
+    return n
+
+
+# ── Queries (on the dataset) ──
+
+@benchmark("latest", unit="calls")
+def bench_latest(ds):
+    """torque_store.latest(), the /torque lookup."""
+    for _ in range(200):
+        torque_store.latest()
+    return 200
+
+
+@benchmark("range_scan", unit="rows", cap=250_000)
+def bench_range_scan(ds, limit):
+    """calibrated_chunks() over the middle 10 % of the time range (at most `limit` rows), one sensor."""
+    span = min((ds.end_us - START_US) // 10, int(limit * 1e6 / RATE_HZ))
+    start = START_US + (ds.end_us - START_US - span) // 2
+    rows = 0
+    for chunk in torque_store.calibrated_chunks(start, start + span, "sensor-1"):
+        rows += len(chunk[0])
+    return rows
+
+
+@benchmark("downsample", unit="calls")
+def bench_downsample(ds):
+    """trend() to 1000 points over the full range, the /series rollup path."""
+    for _ in range(5):
+        torque_store.trend(max_points=1000)
+    return 5
+
+
+@benchmark("resample", unit="rows", cap=1_000_000)
+def bench_resample(ds, limit):
+    """resample() of the middle `limit` rows' time range to a 100 Hz linear grid, the /series?rate path."""
+    n = min(limit, ds.n)
+    span = int((n // SENSORS) * 1e6 / RATE_HZ)
+    start = START_US + (ds.end_us - START_US - span) // 2
+    result = resample.resample(start, start + span - 1, rate_hz=100.0, mode="linear")
+    return n if result else 0
+
+
+@benchmark("summary", unit="calls")
+def bench_summary(ds):
+    """summary() over the full range, the /stats path."""
+    for _ in range(5):
+        torque_store.summary()
+    return 5
+
+
+@benchmark("export_csv", unit="rows", cap=1_000_000)
+def bench_export_csv(ds, limit):
+    """csv_chunks() over the first `limit` rows' time range."""
+    end = START_US + int((min(limit, ds.n) // SENSORS) * 1e6 / RATE_HZ) - 1
+    out = io.StringIO()
+    for text in exporters.csv_chunks(START_US, end):
+        out.write(text)
+    return out.getvalue().count("\n") - 1
+
+
+@benchmark("export_pdf", unit="reports")
+def bench_export_pdf(ds):
+    """pdf_report() over the full range."""
+    exporters.pdf_report()
+    return 1
+
+
+# ── Harness ──
+
+def run(ds, name, repeat):
+    fn, unit, cap = BENCHMARKS[name]
+    best = None
+    items = 0
+    for _ in range(repeat):
+        torque_store.DB_FILE = ds.path
+        began = time.perf_counter()
+        items = fn(ds, cap) if cap else fn(ds)
+        elapsed = time.perf_counter() - began
+        best = elapsed if best is None else min(best, elapsed)
+    torque_store.DB_FILE = ds.path
+    return {
+        "benchmark": name,
+        "n": ds.n,
+        "items": int(items),
+        "unit": unit,
+        "seconds": best,
+        "per_s": items / best if best else None,
+        "ns_per_item": best / items * 1e9 if items else None,
+        "repeat": repeat,
+    }
+
+
+def environment():
+    try:
+        rev = subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True,
+                             text=True, timeout=5).stdout.strip() or None
+    except (OSError, subprocess.SubprocessError):
+        rev = None
+    return {
+        "benchmark": "_meta",
+        "git": rev,
+        "python": platform.python_version(),
+        "numpy": np.__version__,
+        "sqlite": torque_store.sqlite3.sqlite_version,
+        "machine": platform.machine(),
+        "processor": platform.processor() or None,
+        "cpus": os.cpu_count(),
+        "time_us": torque_store.now_us(),
+    }
+
+
+def compare(results, baseline_path, tolerance):
+    """Benchmarks whose throughput fell more than tolerance below the baseline."""
+    with open(baseline_path) as f:
+        baseline = {(r["benchmark"], r["n"]): r for r in map(json.loads, f)
+                    if r.get("benchmark") != "_meta"}
+    slower = []
+    for r in results:
+        base = baseline.get((r["benchmark"], r["n"]))
+        if base and base.get("per_s") and r["per_s"] is not None:
+            ratio = r["per_s"] / base["per_s"]
+            if ratio < 1 - tolerance:
+                slower.append((r["benchmark"], r["n"], ratio))
+    return slower
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark decode, storage and query hot paths")
+    parser.add_argument("--sizes", nargs="+", type=float, default=[1e4, 1e5],
+                        help="dataset sizes in samples (1e4 … 1e9)")
+    parser.add_argument("--only", nargs="+", choices=sorted(BENCHMARKS), help="benchmarks to run")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per benchmark; the best is kept")
+    parser.add_argument("--data-dir", default="bench_data", help="where datasets are cached")
+    parser.add_argument("--out", default=None, help="write JSON lines here instead of stdout")
+    parser.add_argument("--compare", default=None, help="baseline JSON lines from an earlier run")
+    parser.add_argument("--tolerance", type=float, default=0.2,
+                        help="allowed throughput drop against the baseline (0.2 = 20 %%)")
+    args = parser.parse_args()
+
+    os.makedirs(args.data_dir, exist_ok=True)
+    names = args.only or list(BENCHMARKS)
+    out = open(args.out, "w") if args.out else sys.stdout
+    results = []
+    try:
+        out.write(json.dumps(environment()) + "\n")
+        for size in args.sizes:
+            ds = Dataset(size, args.data_dir)
+            if ds.build_s is not None:
+                out.write(json.dumps({"benchmark": "_dataset", "n": ds.n, "seconds": ds.build_s,
+                                      "per_s": ds.n / ds.build_s}) + "\n")
+            for name in names:
+                result = run(ds, name, args.repeat)
+                results.append(result)
+                out.write(json.dumps(result) + "\n")
+                out.flush()
+                print(f"{name:<15} n={ds.n:<12} {result['items']:>10} {result['unit']:<8}"
+                      f"{result['seconds'] * 1e3:>10.2f} ms {result['ns_per_item']:>12.0f} ns/item",
+                      file=sys.stderr)
+    finally:
+        if args.out:
+            out.close()
+
+    if args.compare:
+        slower = compare(results, args.compare, args.tolerance)
+        for name, n, ratio in slower:
+            print(f"REGRESSION {name} n={n}: {ratio:.0%} of baseline throughput", file=sys.stderr)
+        sys.exit(1 if slower else 0)
+
+
+if __name__ == "__main__":
+    main()
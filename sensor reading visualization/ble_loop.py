@@ -0,0 +1,54 @@
+"""
+One long-lived asyncio event loop for all BLE work.
+
+Flask handlers and Qt slots are synchronous and run on threads of their
+own. Instead of spinning up a thread with asyncio.run() per action, or a
+fresh event loop per request, they hand coroutines to this loop with
+submit() or run(). Scanning and every sensor connection are then tasks on
+the one loop: a coroutine frame of a few KB each, and no thread per
+connection.
+"""
+
+import asyncio
+import threading
+
+_loop = None
+_thread = None
+_lock = threading.Lock()
+
+
+def loop():
+    """The shared event loop, started on a daemon thread on first use."""
+    global _loop, _thread
+    with _lock:
+        if _loop is None or _loop.is_closed() or not _thread.is_alive():
+            ready = threading.Event()
+            _loop = asyncio.new_event_loop()
+            _thread = threading.Thread(target=_serve, args=(_loop, ready), name="ble-loop", daemon=True)
+            _thread.start()
+            ready.wait()
+        return _loop
+
+
+def _serve(event_loop, ready):
+    asyncio.set_event_loop(event_loop)
+    event_loop.call_soon(ready.set)
+    event_loop.run_forever()
+
+
+def submit(coro):
+    """Schedule coro on the shared loop; returns a concurrent.futures.Future."""
+    return asyncio.run_coroutine_threadsafe(coro, loop())
+
+
+def run(coro, timeout=None):
+    """Run coro on the shared loop and wait for its result (synchronous callers only)."""
+    if threading.current_thread() is _thread:
+        coro.close()
+        raise RuntimeError("ble_loop.run() called from the loop itself; await the coroutine instead")
+    return submit(coro).result(timeout)
+
+
+def call_soon(fn, *args):
+    """Run fn(*args) on the loop thread, e.g. to set an asyncio.Event from Flask."""
+    loop().call_soon_threadsafe(fn, *args)
@@ -0,0 +1,192 @@
+"""
+Sample timestamps reconstructed from the sensor's own clock.
+
+Stamping samples with their arrival time squeezes a burst of notifications
+onto one instant and drifts with BLE scheduling. When frames carry the
+device tick counter of their first sample (config "tickBytes"), each
+sensor gets a DeviceClock that fits host arrival time against device ticks
+with an online linear regression:
+
+  host_us ≈ intercept + slope * device_seconds
+
+The fit is a weighted least squares over exponentially decaying sums, so
+it follows slow crystal drift (time constant FORGET_S of device time) at
+a fixed cost per batch. Arrivals that sit too far from the fit (late
+connection events, retransmissions) are rejected as outliers. Until the
+fit spans MIN_SPAN_S, the slope is held at the nominal tick rate and only
+the offset is fitted. Every sample then gets intercept + slope * its own
+device time: evenly spaced, drift-corrected, and offset by the mean
+delivery latency after the sample was taken.
+"""
+
+import threading
+
+import numpy as np
+
+FORGET_S = 600.0        # device seconds for a point's weight to fall to 1/e
+MIN_SPAN_S = 10.0       # device time the fit must span before the slope is fitted
+REJECT_K = 6.0          # outlier threshold in units of the mean absolute residual
+MIN_REJECT_US = 5_000   # never reject arrivals closer than this to the fit
+RESET_FRAMES = 200      # consecutive rejected frames that mean the clock itself jumped
+
+
+class DeviceClock:
+    """Tick-to-host mapping for one sensor; timestamps() is called per batch by the writer."""
+
+    def __init__(self, tick_hz, tick_bytes, sample_ticks=None):
+        self.tick_hz = float(tick_hz)
+        self.modulus = 1 << (8 * tick_bytes)
+        self.fixed_sample_ticks = sample_ticks  # ticks between samples; estimated when None
+        self._lock = threading.RLock()  # timestamps() re-enters itself after a clock reset
+        self._reset()
+
+    def _reset(self):
+        self.sample_ticks = self.fixed_sample_ticks
+        self.x0 = None          # unwrapped tick and host µs of the first frame (origin)
+        self.y0 = None
+        self.last_raw = None    # last raw tick, for unwrapping
+        self.last_ext = None    # ... and its unwrapped value
+        self.first_x = None     # device seconds of the first and newest accepted frames
+        self.last_x = 0.0
+        self.sums = np.zeros(5)  # weighted Σw, Σwx, Σwy, Σwxx, Σwxy
+        self.resid = 0.0        # weighted mean absolute residual (µs)
+        self.rejected_run = 0
+        self.accepted = 0
+        self.rejected = 0
+        self.last_ts = None     # newest timestamp handed out, to keep time monotonic
+
+    # ── Fit ──
+
+    def _unwrap(self, raw):
+        raw = np.asarray(raw, dtype=np.int64)
+        if self.last_raw is None:
+            prev_raw, prev_ext = raw[0], raw[0]
+        else:
+            prev_raw, prev_ext = self.last_raw, self.last_ext
+        steps = np.diff(np.concatenate([[prev_raw], raw])) % self.modulus
+        ext = prev_ext + np.cumsum(steps)
+        self.last_raw, self.last_ext = int(raw[-1]), int(ext[-1])
+        return ext
+
+    def _line(self):
+        """(intercept µs, slope µs per device second) of the current fit."""
+        w, sx, sy, sxx, sxy = self.sums
+        if w <= 0:
+            return 0.0, 1e6
+        mx, my = sx / w, sy / w
+        if self.first_x is not None and self.last_x - self.first_x >= MIN_SPAN_S:
+            var = sxx / w - mx * mx
+            if var > 0:
+                slope = (sxy / w - mx * my) / var
+                return my - slope * mx, slope
+        return my - 1e6 * mx, 1e6
+
+    def _fit(self, x, y):
+        """Add (device s, host µs offset) points, rejecting outliers against the fit so far."""
+        intercept, slope = self._line()
+        resid = y - (intercept + slope * x)
+        if self.accepted >= 10:
+            limit = max(REJECT_K * self.resid, MIN_REJECT_US)
+            keep = np.abs(resid) <= limit
+        else:
+            keep = np.ones(len(x), dtype=bool)
+        n_keep = int(keep.sum())
+        self.rejected += len(x) - n_keep
+        if n_keep == 0:
+            self.rejected_run += len(x)
+            return self.rejected_run < RESET_FRAMES
+        self.rejected_run = 0
+        x, y, resid = x[keep], y[keep], resid[keep]
+
+        newest = float(x.max())
+        decay = np.exp(-(max(newest, self.last_x) - self.last_x) / FORGET_S)
+        w = np.exp(-(max(newest, self.last_x) - x) / FORGET_S)
+        self.sums = self.sums * decay + np.array(
+            [w.sum(), (w * x).sum(), (w * y).sum(), (w * x * x).sum(), (w * x * y).sum()])
+        if self.accepted:
+            self.resid = 0.9 * self.resid + 0.1 * float(np.mean(np.abs(resid)))
+        if self.first_x is None:
+            self.first_x = float(x.min())
+        self.last_x = max(newest, self.last_x)
+        self.accepted += n_keep
+        return True
+
+    def _estimate_sample_ticks(self, ticks, per_frame):
+        if self.fixed_sample_ticks is not None or len(ticks) < 2:
+            return
+        steps = np.diff(ticks) / per_frame[:-1]
+        steps = steps[(per_frame[:-1] > 0) & (steps > 0)]
+        if not len(steps):
+            return
+        # Mean of the steps near the median: frames lost in between are left
+        # out, and integer tick rounding averages away
+        median = np.median(steps)
+        estimate = float(steps[np.abs(steps - median) <= 0.1 * median].mean())
+        self.sample_ticks = estimate if self.sample_ticks is None else 0.9 * self.sample_ticks + 0.1 * estimate
+
+    # ── Timestamps ──
+
+    def timestamps(self, raw_ticks, arrival_us, per_frame):
+        """
+        Frames of this sensor in arrival order: device tick of each frame's
+        first sample, host arrival µs, samples per frame. Returns one epoch µs
+        timestamp per sample (int64), monotonic across calls.
+        """
+        per_frame = np.asarray(per_frame, dtype=np.int64)
+        arrival_us = np.asarray(arrival_us, dtype=np.int64)
+        with self._lock:
+            ticks = self._unwrap(raw_ticks)
+            if self.x0 is None:
+                self.x0, self.y0 = int(ticks[0]), int(arrival_us[0])
+            x = (ticks - self.x0) / self.tick_hz
+            self._estimate_sample_ticks(ticks, per_frame)
+            sample_ticks = self.sample_ticks or 0.0
+            # A frame is sent once its last sample is taken, so fit arrival to that one
+            last_x = x + (per_frame - 1) * sample_ticks / self.tick_hz
+            if not self._fit(last_x, (arrival_us - self.y0).astype(np.float64)):
+                # The device clock jumped (reset or swap): start a new fit from here
+                self._reset()
+                return self.timestamps(raw_ticks, arrival_us, per_frame)
+            intercept, slope = self._line()
+
+            first = np.cumsum(per_frame) - per_frame
+            within = np.arange(int(per_frame.sum())) - np.repeat(first, per_frame)
+            sample_x = np.repeat(x, per_frame) + within * sample_ticks / self.tick_hz
+            ts = np.round(self.y0 + intercept + slope * sample_x).astype(np.int64)
+            if self.last_ts is not None:
+                ts = np.maximum(ts, self.last_ts + 1)
+            ts = np.maximum.accumulate(ts)
+            if len(ts):
+                self.last_ts = int(ts[-1])
+            return ts
+
+    def state(self):
+        """Fit parameters, for diagnostics."""
+        with self._lock:
+            intercept, slope = self._line()
+            return {
+                "drift_ppm": (slope / 1e6 - 1) * 1e6,
+                "offset_us": intercept,
+                "span_s": self.last_x - (self.first_x or 0.0),
+                "residual_us": self.resid,
+                "sample_ticks": self.sample_ticks,
+                "accepted": self.accepted,
+                "rejected": self.rejected,
+            }
+
+
+class ClockBank:
+    """One DeviceClock per sensor."""
+
+    def __init__(self, tick_hz, tick_bytes, sample_ticks=None):
+        self.params = (tick_hz, tick_bytes, sample_ticks)
+        self.clocks = {}
+
+    def timestamps(self, sensor_id, raw_ticks, arrival_us, per_frame):
+        clock = self.clocks.get(sensor_id)
+        if clock is None:
+            clock = self.clocks[sensor_id] = DeviceClock(*self.params)
+        return clock.timestamps(raw_ticks, arrival_us, per_frame)
+
+    def state(self):
+        return {sensor_id: clock.state() for sensor_id, clock in list(self.clocks.items())}
@@ -0,0 +1,351 @@
+"""
+Export helpers that stream straight out of torque_store.
+"""
+
+import resample
+import torque_store
+
+CSV_HEADER = "id,timestamp_us,raw,torque_value,sensor_id\n"
+_CSV_ROW = "%d,%d,%d,%r,%s\n"
+GRID_CSV_HEADER = "timestamp_us,sensor_id,torque_value\n"  # empty torque_value = no data
+GRID_ROWS = 100_000  # grid points per exported chunk
+
+# format -> (mimetype, download name) for the /export route
+EXPORT_FORMATS = {
+    "csv": ("text/csv", "torque_data.csv"),
+    "arrow": ("application/vnd.apache.arrow.stream", "torque_data.arrows"),
+    "parquet": ("application/vnd.apache.parquet", "torque_data.parquet"),
+}
+
+
+class FilterError(ValueError):
+    pass
+
+
+def parse_filters(args):
+    """
+    Pull the optional start/end/sensor/calibration filters out of a request's
+    query args. start / end may be epoch microseconds or ISO8601 text;
+    calibration pins a calibration version instead of the current table.
+    """
+    try:
+        start = torque_store.to_us(args.get("start") or None)
+        end = torque_store.to_us(args.get("end") or None)
+    except ValueError as e:
+        raise FilterError(f"Invalid time filter: {str(e)}")
+    version = args.get("calibration") or None
+    try:
+        calibration = torque_store.load_calibration(None if version is None else int(version))
+    except (ValueError, LookupError) as e:
+        raise FilterError(f"Invalid calibration: {str(e)}")
+    return {"start": start, "end": end, "sensor_id": args.get("sensor") or None,
+            "calibration": calibration}
+
+
+def parse_resample(args):
+    """
+    Optional ?rate (Hz) &mode (linear|hold|mean, default linear) &max_gap_ms
+    for a uniform-grid result; None when no rate is given.
+    """
+    if not args.get("rate"):
+        return None
+    try:
+        rate_hz = float(args["rate"])
+        max_gap = args.get("max_gap_ms") or None
+        max_gap_us = None if max_gap is None else float(max_gap) * 1e3
+    except ValueError as e:
+        raise FilterError(f"Invalid resampling: {str(e)}")
+    mode = args.get("mode", "linear").lower()
+    if rate_hz <= 0 or mode not in resample.MODES:
+        raise FilterError(f"Invalid resampling: rate must be positive and mode one of "
+                          f"{', '.join(resample.MODES)}")
+    return {"rate_hz": rate_hz, "mode": mode, "max_gap_us": max_gap_us}
+
+
+def csv_chunks(start=None, end=None, sensor_id=None, calibration=None):
+    """
+    Generate the CSV export as text chunks, one per store chunk.
+    Yields nothing at all when the filters match no rows.
+    """
+    header_sent = False
+    for ids, ts, raw, torque, sensors in torque_store.calibrated_chunks(start, end, sensor_id, calibration):
+        body = "".join([_CSV_ROW % row for row in zip(ids.tolist(), ts.tolist(), raw.tolist(),
+                                                        torque.tolist(), sensors)])
+        if not header_sent:
+            header_sent = True
+            body = CSV_HEADER + body
+        yield body
+
+
+
+class _ChunkSink:
+    """Write-only file object that hands its buffered bytes back on take()."""
+
+    def __init__(self):
+        self._parts = []
+        self._pos = 0
+        self.closed = False
+
+    def write(self, data):
+        self._parts.append(bytes(data))
+        self._pos += len(data)
+        return len(data)
+
+    def tell(self):
+        return self._pos
+
+    def flush(self):
+        pass
+
+    def close(self):
+        self.closed = True
+
+    def take(self):
+        data = b"".join(self._parts)
+        self._parts = []
+        return data
+
+
+def _arrow_schema():
+    import pyarrow as pa
+    return pa.schema([
+        ("id", pa.int64()),
+        ("timestamp_us", pa.int64()),  # microseconds since the Unix epoch, UTC
+        ("raw", pa.int32()),  # ADC counts as stored
+        ("torque_value", pa.float32()),  # calibrated on export
+        ("sensor_id", pa.dictionary(pa.int32(), pa.string())),
+    ])
+
+
+def _record_batch(chunk, schema):
+    import numpy as np
+    import pyarrow as pa
+
+    ids, stamps, raw, torque, sensors = chunk
+    return pa.record_batch([
+        pa.array(ids),
+        pa.array(stamps),
+        pa.array(raw.astype(np.int32)),
+        pa.array(torque.astype(np.float32)),
+        pa.array(sensors, type=pa.string()).dictionary_encode(),
+    ], schema=schema)
+
+
+def columnar_chunks(fmt, start=None, end=None, sensor_id=None, calibration=None):
+    """
+    Generate an Arrow IPC stream ("arrow") or Parquet file ("parquet") as byte
+    chunks, one record batch / row group per store chunk.
+    Yields nothing at all when the filters match no rows.
+    """
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+
+    schema = _arrow_schema()
+    sink = _ChunkSink()
+    writer = None
+    for chunk in torque_store.calibrated_chunks(start, end, sensor_id, calibration):
+        batch = _record_batch(chunk, schema)
+        if writer is None:
+            if fmt == "parquet":
+                writer = pq.ParquetWriter(sink, schema, compression="zstd")
+            else:
+                writer = pa.ipc.new_stream(sink, schema)
+        writer.write_batch(batch)
+        data = sink.take()
+        if data:
+            yield data
+    if writer is not None:
+        writer.close()
+        yield sink.take()
+
+
+def _grid_blocks(result):
+    """(ts, sensor_id, values, valid) blocks of at most GRID_ROWS points, sensor by sensor."""
+    grid = result["grid"]
+    for sid, (values, valid) in result["sensors"].items():
+        for lo in range(0, grid.n, GRID_ROWS):
+            hi = min(lo + GRID_ROWS, grid.n)
+            yield grid.times(lo, hi), sid, values[lo:hi], valid[lo:hi]
+
+
+def resampled_chunks(fmt, result):
+    """
+    Export a resample.resample() result as csv, arrow or parquet chunks, long
+    format (timestamp_us, sensor_id, torque_value). Grid points without data
+    are an empty CSV field / a null, never a made-up value.
+    """
+    if fmt == "csv":
+        header_sent = False
+        for ts, sid, values, valid in _grid_blocks(result):
+            text = [f"{t},{sid},{v!r}\n" if ok else f"{t},{sid},\n"
+                    for t, v, ok in zip(ts.tolist(), values.tolist(), valid.tolist())]
+            if not header_sent:
+                header_sent = True
+                text.insert(0, GRID_CSV_HEADER)
+            yield "".join(text)
+        return
+
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+
+    schema = pa.schema([
+        ("timestamp_us", pa.int64()),  # grid point, microseconds since the Unix epoch, UTC
+        ("sensor_id", pa.dictionary(pa.int32(), pa.string())),
+        ("torque_value", pa.float32()),  # null where the grid point has no data
+    ])
+    sink = _ChunkSink()
+    writer = None
+    for ts, sid, values, valid in _grid_blocks(result):
+        batch = pa.record_batch([
+            pa.array(ts),
+            pa.array([sid] * len(ts), type=pa.string()).dictionary_encode(),
+            pa.array(values.astype("float32"), mask=~valid),
+        ], schema=schema)
+        if writer is None:
+            if fmt == "parquet":
+                writer = pq.ParquetWriter(sink, schema, compression="zstd")
+            else:
+                writer = pa.ipc.new_stream(sink, schema)
+        writer.write_batch(batch)
+        data = sink.take()
+        if data:
+            yield data
+    if writer is not None:
+        writer.close()
+        yield sink.take()
+
+
+def pdf_report(start=None, end=None, sensor_id=None, calibration=None):
+    """
+    Render a one-page summary report (stats, trend, histogram, peaks) into a
+    BytesIO. Everything comes from the store's aggregate tables, so the cost
+    does not grow with the number of raw samples. Returns None if no data.
+    """
+    import io
+    from datetime import datetime
+    from reportlab.lib.pagesizes import A4
+    from reportlab.pdfgen import canvas
+
+    if calibration is None:
+        calibration = torque_store.load_calibration()
+    stats = torque_store.summary(start, end, sensor_id, calibration)
+    if stats is None:
+        return None
+    trend = torque_store.trend(start, end, sensor_id, max_points=400, calibration=calibration)
+    hist = torque_store.histogram(sensor_id, calibration)
+    peaks = torque_store.peaks(start, end, sensor_id, limit=10, calibration=calibration)
+    missing = torque_store.gap_summary(start, end, sensor_id)
+
+    buf = io.BytesIO()
+    c = canvas.Canvas(buf, pagesize=A4)
+    width, height = A4
+
+    c.setFont("Helvetica-Bold", 16)
+    c.drawString(50, height - 50, "Torque Sensor Report")
+    c.setFont("Helvetica", 10)
+    c.drawString(50, height - 68, f"Generated: {datetime.now().strftime('%Y-%m-%d %H:%M:%S')}")
+    c.drawString(50, height - 82, f"Range: {_minute_text(stats['first'])} – {_minute_text(stats['last'])} UTC"
+                                  f"    Sensor: {sensor_id or 'all'}")
+
+    # ── Stats ──
+    y = height - 110
+    c.setFont("Helvetica-Bold", 12)
+    c.drawString(50, y, "Summary")
+    c.setFont("Helvetica", 10)
+    for label, value in (
+        ("Samples", f"{stats['n']}"),
+        ("Mean", f"{stats['mean']:.2f} N·cm"),
+        ("Std dev", f"{stats['std']:.2f} N·cm"),
+        ("RMS", f"{stats['rms']:.2f} N·cm"),
+        ("Min", f"{stats['min']:.2f} N·cm"),
+        ("Max", f"{stats['max']:.2f} N·cm"),
+        ("Peak-to-peak", f"{stats['p2p']:.2f} N·cm"),
+        ("Missing data", f"{missing['missing_us'] / 1e6:.1f} s in {missing['gaps']} gaps"
+                         f", {missing['lost_samples']} samples lost"),
+    ):
+        y -= 14
+        c.drawString(60, y, label)
+        c.drawString(160, y, value)
+
+    # ── Trend plot (per-bucket mean with min/max band) ──
+    _draw_trend(c, trend, 50, 330, width - 100, 190)
+
+    # ── Histogram ──
+    _draw_histogram(c, hist, 50, 90, (width - 100) / 2 - 10, 170)
+
+    # ── Peak events ──
+    x = width / 2 + 10
+    y = 260
+    c.setFont("Helvetica-Bold", 12)
+    c.drawString(x, y, "Peak events (per minute)")
+    c.setFont("Helvetica", 9)
+    for bucket, sid, peak in peaks:
+        y -= 14
+        c.drawString(x, y, f"{_minute_text(bucket)}  {sid}")
+        c.drawRightString(width - 50, y, f"{peak:.2f} N·cm")
+
+    c.showPage()
+    c.save()
+    buf.seek(0)
+    return buf
+
+
+def _minute_text(ts_us):
+    return torque_store.format_us(ts_us)[:16].replace("T", " ")
+
+
+def _draw_trend(c, points, x, y, w, h):
+    c.setFont("Helvetica-Bold", 12)
+    c.drawString(x, y + h + 8, "Trend")
+    c.rect(x, y, w, h)
+    if not points:
+        return
+    lo = min(p[2] for p in points)
+    hi = max(p[3] for p in points)
+    span = (hi - lo) or 1.0
+    dx = w / max(len(points) - 1, 1)
+
+    def py(v):
+        return y + (v - lo) / span * h
+
+    c.setStrokeColorRGB(0.75, 0.85, 0.75)
+    for i, (_, _, pmin, pmax) in enumerate(points):
+        c.line(x + i * dx, py(pmin), x + i * dx, py(pmax))
+    c.setStrokeColorRGB(0.0, 0.6, 0.3)
+    path = c.beginPath()
+    path.moveTo(x, py(points[0][1]))
+    for i, p in enumerate(points[1:], 1):
+        path.lineTo(x + i * dx, py(p[1]))
+    c.drawPath(path, stroke=1, fill=0)
+    c.setStrokeColorRGB(0, 0, 0)
+
+    c.setFont("Helvetica", 8)
+    c.drawString(x + 2, y + h - 10, f"{hi:.2f}")
+    c.drawString(x + 2, y + 2, f"{lo:.2f}")
+    c.drawString(x, y - 10, _minute_text(points[0][0]))
+    c.drawRightString(x + w, y - 10, _minute_text(points[-1][0]))
+
+
+def _draw_histogram(c, hist, x, y, w, h, max_bars=40):
+    c.setFont("Helvetica-Bold", 12)
+    c.drawString(x, y + h + 8, "Histogram (all history)")
+    c.rect(x, y, w, h)
+    if not hist:
+        return
+    # Merge neighbouring bins so the bar count stays bounded
+    lo = hist[0][0]
+    hi = max(high for _, high, _ in hist)
+    bin_width = min(high - low for low, high, _ in hist)
+    bar_width = max((hi - lo) / max_bars, bin_width)
+    bars = [0] * max(1, min(max_bars, int((hi - lo) / bar_width + 0.5)))
+    for low, _, n in hist:
+        bars[min(int((low - lo) / bar_width), len(bars) - 1)] += n
+    tallest = max(bars)
+    bw = w / len(bars)
+    c.setFillColorRGB(0.0, 0.6, 0.3)
+    for i, n in enumerate(bars):
+        c.rect(x + i * bw, y, bw * 0.9, n / tallest * h, stroke=0, fill=1)
+    c.setFillColorRGB(0, 0, 0)
+    c.setFont("Helvetica", 8)
+    c.drawString(x, y - 10, f"{lo:.1f}")
+    c.drawRightString(x + w, y - 10, f"{hi:.1f} N·cm")
@@ -1,20 +1,16 @@
-from flask import Flask, render_template, jsonify, send_file
-import sqlite3
-import asyncio
-import threading
-import platform
+from flask import Flask, render_template, jsonify, send_file, Response, stream_with_context
 import json
-from bleak import BleakScanner
-from bleak.backends.device import BLEDevice
-from bleak.backends.scanner import AdvertisementData
+import os
 from flask import request
-
-# On Linux, force the random-address client
-if platform.system() == "Linux":
-    from bleak.backends.bluezdbus import BlueZClient as BLEClient, AddressType
-else:
-    from bleak import BleakClient as BLEClient
-    AddressType = None
+import torque_store
+import exporters
+import alerts
+import cycles
+import metrics
+import resample
+import stats
+from ingest import IngestManager
+from latency import LatencyTracker
 
 app = Flask(__name__, static_folder="static", template_folder="templates")
 
@@ -34,150 +30,56 @@ MANUFACTURER_NAME = CONFIG.get("manufacturerName", "Renesas")
 MODEL_NUMBER = CONFIG.get("modelNumber", "DA14531")
 OFFSET = CONFIG.get("offset", 880804)  # Approx raw value for 2.1 mV (zero torque, 10.5% of 8,388,607)
 SCALE = CONFIG.get("scale", 1.33e-7)  # Placeholder: N·cm per count, assumes ±1 N·cm max torque
-
-DB_FILE = "torque_data.db"
-
-# Global status and thread control
-status = "Disconnected"
-ble_thread = None
-stop_ble = False
+SAMPLE_STRIDE = CONFIG.get("sampleStride", 3)  # bytes per 24-bit sample in a notification frame
+SEQUENCE_BYTES = CONFIG.get("sequenceBytes", 0)  # frame sequence counter ahead of the samples; 0 = none
+# Device tick counter after the sequence number: bytes (0 = none, stamp on arrival), rate,
+# and ticks between samples (None = estimate from consecutive frames)
+TICK_BYTES = CONFIG.get("tickBytes", 0)
+TICK_HZ = CONFIG.get("tickHz", 32768)
+SAMPLE_TICKS = CONFIG.get("sampleTicks")
+# Calibrated samples held in memory per sensor for /recent: window and the highest expected rate
+RECENT_SECONDS = CONFIG.get("recentSeconds", 60)
+RECENT_RATE_HZ = CONFIG.get("recentRateHz", 1000)
+# Tightening cycles: start above / end at or below these torques (N·cm), ignore shorter than min
+CYCLE_START = CONFIG.get("cycleStartLevel", cycles.START_LEVEL)
+CYCLE_END = CONFIG.get("cycleEndLevel", cycles.END_LEVEL)
+CYCLE_MIN_MS = CONFIG.get("cycleMinMs", cycles.MIN_CYCLE_MS)
+# UDP port on 127.0.0.1 for simulated sensors (loadgen.py); 0 = off
+LOCAL_INGEST_PORT = CONFIG.get("localIngestPort", 0)
+# /push timestamps come from the client's clock; only count them as device
+# stamps in the latency stats when that clock is known to be synchronised
+PUSH_CLOCK_TRUSTED = CONFIG.get("pushClockTrusted", False)
+
+DB_FILE = torque_store.DB_FILE
+
+# BLE ingestion for every matching sensor in range
+# Samples are stored as raw counts; OFFSET / SCALE only seed the calibration table
+alert_engine = alerts.AlertEngine()
+cycle_tracker = cycles.CycleTracker(CYCLE_START, CYCLE_END, CYCLE_MIN_MS)
+latency = LatencyTracker()
+ingest = IngestManager(SERVICE_UUID, TORQUE_UUID, SENSOR_NAME, MANUFACTURER_NAME, SAMPLE_STRIDE,
+                       alerts=alert_engine, cycles=cycle_tracker, latency=latency,
+                       seq_bytes=SEQUENCE_BYTES, tick_bytes=TICK_BYTES, tick_hz=TICK_HZ,
+                       sample_ticks=SAMPLE_TICKS, recent_s=RECENT_SECONDS, recent_hz=RECENT_RATE_HZ)
+
+# Scrape-time gauges
+metrics.Gauge("torque_ingest_queue_frames", "Frames queued for the writer",
+              collect=lambda: {(): ingest.backlog()})
+metrics.Gauge("torque_sensor_connected", "1 while a sensor is streaming", ["sensor"],
+              collect=lambda: {(s["sensor_id"],): int(s["connected"]) for s in ingest.sensors()})
+metrics.Gauge("torque_store_size_bytes", "Database file plus write-ahead log",
+              collect=lambda: {(): torque_store.db_size_bytes()})
+metrics.Gauge("torque_clock_drift_ppm", "Fitted device clock rate against the host clock", ["sensor"],
+              collect=lambda: {(sid,): c["drift_ppm"] for sid, c in
+                               (ingest.clocks.state() if ingest.clocks else {}).items()})
 
 def init_db():
-    conn = sqlite3.connect(DB_FILE)
-    conn.execute("""
-        CREATE TABLE IF NOT EXISTS torque_data (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,
-            torque_value REAL
-        )
-    """)
-    conn.commit()
-    conn.close()
-
-def save_val(val):
-    print(f"Saving torque value: {val:.2f} N·cm")
-    conn = sqlite3.connect(DB_FILE)
-    conn.execute("INSERT INTO torque_data (torque_value) VALUES (?)", (val,))
-    conn.commit()
-    conn.close()
-
-async def ble_loop():
-    global status, stop_ble
-    while not stop_ble:
-        # ── 1) Scan with callback ──
-        status = "Scanning…"
-        found = asyncio.Event()
-        device_holder = {}
-
-        def detection_callback(device: BLEDevice, adv: AdvertisementData):
-            if (adv.service_uuids and SERVICE_UUID.lower() in [uuid.lower() for uuid in adv.service_uuids]) or \
-               (device.name and SENSOR_NAME.lower() in device.name.lower()) or \
-               (adv.manufacturer_data and MANUFACTURER_NAME in str(adv.manufacturer_data)):
-                device_holder['dev'] = device
-                device_holder['adv'] = adv
-                found.set()
-
-        scanner = BleakScanner(detection_callback)
-        await scanner.start()
-        try:
-            await asyncio.wait_for(found.wait(), timeout=10.0)
-        except asyncio.TimeoutError:
-            status = "Sensor not found"
-            await scanner.stop()
-            await asyncio.sleep(5.0)
-            continue
-        finally:
-            await scanner.stop()
-
-        if stop_ble:
-            break
-
-        dev = device_holder['dev']
-        adv = device_holder.get('adv', None)
-        status = f"Found {dev.name or dev.address}"
-
-        # ── 2) Connect using full BLEDevice ──
-        try:
-            if platform.system() == "Linux":
-                client = BLEClient(dev.address, address_type=AddressType.random)
-            else:
-                client = BLEClient(dev)
-
-            async with client:
-                if not client.is_connected:
-                    status = "Connection failed"
-                    await asyncio.sleep(5.0)
-                    continue
-
-                status = "Connected ✓"
-                # Verify device has the required service
-                try:
-                    services = await client.get_services()
-                    service_found = False
-                    for service in services:
-                        if service.uuid.lower() == SERVICE_UUID.lower():
-                            service_found = True
-                            break
-                    if not service_found:
-                        status = "Required service not found"
-                        continue
-                except Exception as e:
-                    status = f"Service verification failed: {str(e)}"
-                    continue
-
-                # ── 3) Notification loop ──
-                def notification_handler(sender, data):
-                    global status
-                    try:
-                        # Log raw data for debugging
-                        print(f"Notification raw data (hex): {data.hex()}")
-                        print(f"Notification data length: {len(data)} bytes")
-
-                        # Expect 4 bytes but use first 3 bytes for 24-bit signed integer
-                        if len(data) < 3:
-                            status = f"Unexpected notification data length: {len(data)} bytes (expected at least 3)"
-                            print(status)
-                            return
-
-                        # Extract first 3 bytes for 24-bit signed integer
-                        raw_val = int.from_bytes(data[:3], byteorder="little", signed=True)
-                        print(f"Raw value (integer): {raw_val}")
-
-                        # Log OFFSET and SCALE
-                        print(f"OFFSET: {OFFSET}, SCALE: {SCALE}")
-
-                        # Calculate torque
-                        torque = (raw_val - OFFSET) * SCALE
-                        print(f"Calculated torque: {torque:.2f} N·cm")
-
-                        # Save to database
-                        save_val(torque)
-                        status = f"Streaming: {torque:.2f} N·cm"
-                    except Exception as e:
-                        status = f"Notification error: {str(e)}"
-                        print(f"Notification error details: {str(e)}")
-
-                try:
-                    # Start notifications
-                    await client.start_notify(TORQUE_UUID, notification_handler)
-                    print(f"Subscribed to notifications for UUID: {TORQUE_UUID}")
-                    # Keep connection alive while receiving notifications
-                    while client.is_connected and not stop_ble:
-                        await asyncio.sleep(1.0)
-                    # Stop notifications when loop exits
-                    await client.stop_notify(TORQUE_UUID)
-                except Exception as e:
-                    status = f"Notification setup error: {str(e)}"
-                    print(f"Notification setup error details: {str(e)}")
-                    await asyncio.sleep(5.0)
-                    continue
-
-        except Exception as e:
-            status = f"BLE Error: {str(e)}"
-            print(f"BLE Error details: {str(e)}")
-            await asyncio.sleep(5.0)
-    
-    status = "Disconnected"
+    torque_store.init_db(offset=OFFSET, scale=SCALE)
+    alert_engine.reload()
+
+@app.errorhandler(exporters.FilterError)
+def bad_filter(e):
+    return jsonify({"error": str(e)}), 400
 
 @app.route("/")
 def dashboard():
@@ -185,65 +87,331 @@ def dashboard():
 
 @app.route("/status")
 def get_status():
-    return jsonify({"status": status})
+    return jsonify({"status": ingest.status})
+
+@app.route("/sensors")
+def get_sensors():
+    """Per-sensor link state: status, sample count, reconnects, last torque."""
+    return jsonify({"sensors": ingest.sensors()})
+
+@app.route("/devices")
+def get_devices():
+    """Cached BLE devices that /start connects to without scanning: address type, GATT handle."""
+    return jsonify({"devices": torque_store.list_devices()})
+
+@app.route("/devices/<sensor_id>", methods=["DELETE"])
+def forget_device(sensor_id):
+    """Drop a cached device (e.g. a replaced sensor); it is found again by scanning."""
+    if not torque_store.forget_device(sensor_id):
+        return jsonify({"error": "Unknown device"}), 404
+    return jsonify({"status": "ok"}), 200
 
 @app.route("/torque")
 def get_torque():
-    conn = sqlite3.connect(DB_FILE)
-    row = conn.execute(
-        "SELECT timestamp, torque_value FROM torque_data ORDER BY id DESC LIMIT 1"
-    ).fetchone()
-    conn.close()
+    """
+    Newest sample. "stamps" carries its latency checkpoints (epoch µs) for
+    the dashboard to send back to POST /latency once it is drawn.
+    """
+    row = torque_store.latest()
     if not row:
-        return jsonify({"timestamp": None, "torque_value": None})
-    return jsonify({"timestamp": row[0], "torque_value": row[1]})
+        return jsonify({"timestamp_us": None, "raw": None, "torque_value": None})
+    stamps = latency.checkpoints(row[0])
+    stamps["served_us"] = torque_store.now_us()
+    if stamps["stored_us"] is not None:
+        latency.record("stored_served", [stamps["served_us"] - stamps["stored_us"]])
+    return jsonify({"timestamp_us": row[0], "raw": row[1], "torque_value": row[2], "stamps": stamps})
+
+@app.route("/recent")
+def get_recent():
+    """
+    Live-chart backfill from memory, without touching the database:
+    ?sensor&seconds (last N seconds before each sensor's newest sample) or
+    ?since (epoch µs / ISO8601), &max_points (default 5000) per sensor,
+    thinned by striding. "t" is epoch µs, "v" calibrated torque.
+    """
+    try:
+        seconds = request.args.get("seconds", type=float)
+        since = torque_store.to_us(request.args.get("since") or None)
+    except ValueError:
+        return jsonify({"error": "Invalid since"}), 400
+    max_points = max(1, request.args.get("max_points", 5000, type=int))
+    sensors = {}
+    for sid, (ts, torque) in ingest.recent(request.args.get("sensor") or None, seconds, since).items():
+        step = -(-len(ts) // max_points) if len(ts) > max_points else 1
+        # Stride from the newest sample backwards, so the latest one is always included
+        sensors[sid] = {"t": ts[::-1][::step][::-1].tolist(), "v": torque[::-1][::step][::-1].tolist()}
+    return jsonify({"sensors": sensors})
+
+@app.route("/metrics")
+def get_metrics():
+    """Ingest and storage health in the Prometheus text format; see metrics.py."""
+    return Response(metrics.render(), content_type=metrics.CONTENT_TYPE)
+
+# ── Latency ──
+
+@app.route("/latency", methods=["GET"])
+def get_latency():
+    """
+    Per-hop latency histograms (device → received → stored → served →
+    rendered, and end_to_end), plus the ingest writer's per-batch stages.
+    """
+    return jsonify({"hops": latency.summary(), "writer": ingest.stage_times.summary()})
 
-@app.route("/export_csv")
-def export_csv():
-    import pandas as pd
-    import os
+@app.route("/clock")
+def get_clock():
+    """Per-sensor device clock fit (drift, offset, residual); empty without tickBytes."""
+    return jsonify(ingest.clocks.state() if ingest.clocks else {})
+
+@app.route("/latency", methods=["POST"])
+def report_latency():
+    """
+    The dashboard drew a sample: JSON { "stamps": as served by /torque,
+    "render_ms": time from the response leaving the server to the frame
+    being drawn }. render_ms is measured on the client's own clock (half
+    the round trip plus the time to paint), so client clock skew does not matter.
+    """
+    payload = request.get_json(force=True)
+    try:
+        stamps = payload["stamps"]
+        render_us = float(payload["render_ms"]) * 1e3
+        received_us = int(stamps["received_us"])
+        served_us = int(stamps["served_us"])
+    except (KeyError, TypeError, ValueError) as e:
+        return jsonify({"error": f"Invalid latency report: {str(e)}"}), 400
+    latency.record("served_rendered", [render_us])
+    start_us = stamps.get("device_us") or received_us
+    latency.record("end_to_end", [served_us - start_us + render_us])
+    return jsonify({"status": "ok"}), 200
+
+@app.route("/latency/reset", methods=["POST"])
+def reset_latency():
+    latency.reset()
+    ingest.stage_times.reset()
+    return jsonify({"status": "ok"}), 200
+
+@app.route("/calibration", methods=["GET"])
+def get_calibration():
+    """All calibration versions, oldest first."""
+    return jsonify({"calibrations": torque_store.list_calibrations()})
+
+@app.route("/calibration", methods=["POST"])
+def add_calibration():
+    """
+    Accept JSON { "offset": float, "scale": float, "sensor_id": optional ("*" = all),
+    "valid_from": optional epoch µs or "ISO8601" (default: all history), "note": optional }.
+    Takes effect on every read immediately; stored samples are not rewritten.
+    """
+    payload = request.get_json(force=True)
     try:
-        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "torque_data.csv")
-        df = pd.read_sql("SELECT * FROM torque_data", sqlite3.connect(DB_FILE))
-        if df.empty:
-            return jsonify({"error": "No data available for CSV export"}), 400
-        df.to_csv(path, index=False)
-        return send_file(path, as_attachment=True, download_name="torque_data.csv")
+        version = torque_store.add_calibration(
+            float(payload["offset"]), float(payload["scale"]),
+            payload.get("sensor_id", torque_store.ALL_SENSORS),
+            torque_store.to_us(payload.get("valid_from", 0)),
+            payload.get("note"),
+        )
+    except (KeyError, TypeError, ValueError) as e:
+        return jsonify({"error": f"Invalid calibration: {str(e)}"}), 400
+    return jsonify({"status": "ok", "version": version}), 200
+
+@app.route("/series")
+def get_series():
+    """
+    Chart data for a time range: ?start&end&sensor&max_points (default 1000).
+    Raw samples when they fit in max_points, otherwise about max_points
+    (mean, min, max) buckets: per step_us from raw rows when the range is
+    shorter than max_points minutes, from the minute rollups beyond that.
+    All "t" values are epoch microseconds; ?calibration pins a version.
+    "gaps" lists the no-data intervals in the range: draw them as breaks,
+    not as zero torque.
+
+    With ?rate (Hz) the range is resampled onto a uniform grid instead
+    (?mode=linear|hold|mean, ?max_gap_ms; see resample.py): per sensor one
+    value per grid point start + k * step_us, null where there is no data.
+    max_points then caps the grid length (default 100000).
+    """
+    filters = exporters.parse_filters(request.args)
+    grid_args = exporters.parse_resample(request.args)
+    if grid_args is not None:
+        return _grid_series(filters, grid_args)
+    max_points = request.args.get("max_points", 1000, type=int)
+    # One indexed query for at most max_points + 1 rows tells us whether raw fits
+    chunks = torque_store.calibrated_chunks(chunk_rows=max_points + 1, **filters)
+    chunk = next(chunks, None)
+    chunks.close()
+    if chunk is None or len(chunk[0]) <= max_points:
+        points = []
+        if chunk is not None:
+            _, ts, _, torque, sensors = chunk
+            points = [{"t": t, "v": v, "sensor_id": sid}
+                      for t, v, sid in zip(ts.tolist(), torque.tolist(), sensors)]
+        return jsonify({"resolution": "raw", "points": points, "gaps": _gaps_for(filters)})
+    resolution, step_us, rows = torque_store.overview(max_points=max_points, **filters)
+    points = [
+        {"t": bucket, "mean": mean, "min": lo, "max": hi}
+        for bucket, mean, lo, hi in rows
+    ]
+    return jsonify({"resolution": resolution, "step_us": step_us, "points": points,
+                    "gaps": _gaps_for(filters)})
+
+def _grid_series(filters, grid_args):
+    max_points = request.args.get("max_points", 100_000, type=int)
+    try:
+        result = resample.resample(**filters, **grid_args)
+    except ValueError as e:
+        return jsonify({"error": f"Invalid resampling: {str(e)}"}), 400
+    if result is None:
+        return jsonify({"resolution": "grid", "series": {}, "gaps": []})
+    grid = result["grid"]
+    if grid.n > max_points:
+        return jsonify({"error": f"{grid.n} grid points exceed max_points={max_points}; "
+                                 "lower the rate or narrow the range"}), 400
+    series = {
+        sid: [v if ok else None for v, ok in zip(values.tolist(), valid.tolist())]
+        for sid, (values, valid) in result["sensors"].items()
+    }
+    return jsonify({"resolution": "grid", "mode": result["mode"], "start": grid.origin_us,
+                    "step_us": grid.step_us, "rate_hz": grid.rate_hz, "n": grid.n,
+                    "series": series, "gaps": _gaps_for(filters)})
+
+def _gaps_for(filters):
+    return [
+        {"start": g["start_us"], "end": g["end_us"], "sensor_id": g["sensor_id"],
+         "reason": g["reason"], "lost_samples": g["lost_samples"]}
+        for g in torque_store.list_gaps(filters["start"], filters["end"], filters["sensor_id"])
+    ]
+
+@app.route("/gaps")
+def get_gaps():
+    """
+    No-data intervals overlapping ?start&end for ?sensor: lost frame
+    sequence numbers ("sequence") or a dropped link ("link"), with totals.
+    """
+    filters = exporters.parse_filters(request.args)
+    args = (filters["start"], filters["end"], filters["sensor_id"])
+    return jsonify({"gaps": torque_store.list_gaps(*args), "summary": torque_store.gap_summary(*args)})
+
+@app.route("/stats")
+def get_stats():
+    """
+    n / mean / std / var / rms / min / max / p2p for ?start&end&sensor&calibration,
+    from the minute rollups (bounds are truncated to the minute), plus
+    "missing": the no-data gaps in the range (see /gaps).
+    """
+    filters = exporters.parse_filters(request.args)
+    result = torque_store.summary(**filters)
+    if result is None:
+        return jsonify({"error": "No data in range"}), 404
+    # n counts samples received; "missing" says how much of the range had none
+    result["missing"] = torque_store.gap_summary(filters["start"], filters["end"], filters["sensor_id"])
+    return jsonify(result)
+
+def _spectrogram_for(args):
+    spec = ingest.spectrogram(args.get("sensor") or None)
+    if spec is None:
+        return None, (jsonify({"error": "Unknown sensor; pass ?sensor=<sensor_id>"}), 404)
+    try:
+        since = torque_store.to_us(args.get("since") or None)
+    except ValueError:
+        return None, (jsonify({"error": "Invalid since"}), 400)
+    return (spec, since), None
+
+@app.route("/spectrogram")
+def get_spectrogram():
+    """
+    Rolling STFT of a live sensor: ?sensor&since&max_frames (200)&max_bins (128).
+    Returns frame times (epoch µs), bin frequencies (Hz) and PSD in dB.
+    """
+    found, error = _spectrogram_for(request.args)
+    if error:
+        return error
+    spec, since = found
+    result = spec.spectrogram(since,
+                              request.args.get("max_frames", 200, type=int),
+                              request.args.get("max_bins", 128, type=int))
+    if result is None:
+        return jsonify({"error": "No spectra yet"}), 404
+    return jsonify(result)
+
+@app.route("/spectrum")
+def get_spectrum():
+    """Welch-averaged PSD of a live sensor over its held frames: ?sensor&since."""
+    found, error = _spectrogram_for(request.args)
+    if error:
+        return error
+    result = found[0].welch(found[1])
+    if result is None:
+        return jsonify({"error": "No spectra yet"}), 404
+    return jsonify(result)
+
+def _stream_download(chunks, fmt):
+    """Peek the first chunk so an empty result still gets a JSON 400."""
+    label = fmt.upper()
+    try:
+        first = next(chunks, None)
+        if first is None:
+            return jsonify({"error": f"No data available for {label} export"}), 400
+    except ImportError:
+        return jsonify({"error": "PyArrow library not installed. Install with: pip install pyarrow"}), 500
     except Exception as e:
-        return jsonify({"error": f"CSV export failed: {str(e)}"}), 500
+        return jsonify({"error": f"{label} export failed: {str(e)}"}), 500
+
+    def generate():
+        yield first
+        yield from chunks
+
+    mimetype, filename = exporters.EXPORT_FORMATS[fmt]
+    return Response(
+        stream_with_context(generate()),
+        mimetype=mimetype,
+        headers={"Content-Disposition": f"attachment; filename={filename}"}
+    )
+
+@app.route("/export_csv")
+def export_csv():
+    """
+    Stream the CSV chunk by chunk. Optional query args:
+    start / end (inclusive; epoch microseconds or ISO8601), sensor (sensor_id)
+    and calibration (version number, default: current calibration).
+    """
+    return _stream_download(exporters.csv_chunks(**exporters.parse_filters(request.args)), "csv")
+
+@app.route("/export")
+def export_data():
+    """
+    Streaming export in ?format=csv|arrow|parquet (default csv).
+    arrow is an Arrow IPC stream; both columnar formats keep typed columns.
+    Accepts the same filters as /export_csv, plus ?rate&mode&max_gap_ms to
+    export a uniform grid (as /series) instead of the raw samples.
+    """
+    fmt = request.args.get("format", "csv").lower()
+    if fmt not in exporters.EXPORT_FORMATS:
+        return jsonify({"error": f"Unsupported export format: {fmt}"}), 400
+    filters = exporters.parse_filters(request.args)
+    grid_args = exporters.parse_resample(request.args)
+    if grid_args is not None:
+        try:
+            result = resample.resample(**filters, **grid_args)
+        except ValueError as e:
+            return jsonify({"error": f"Invalid resampling: {str(e)}"}), 400
+        if result is None:
+            return jsonify({"error": f"No data available for {fmt.upper()} export"}), 400
+        return _stream_download(exporters.resampled_chunks(fmt, result), fmt)
+    if fmt == "csv":
+        chunks = exporters.csv_chunks(**filters)
+    else:
+        chunks = exporters.columnar_chunks(fmt, **filters)
+    return _stream_download(chunks, fmt)
 
 @app.route("/export_pdf")
 def export_pdf():
-    import tempfile
-    import os
+    """Fixed-size summary report; accepts the same filters as /export_csv."""
     try:
-        from reportlab.pdfgen import canvas
-        
-        conn = sqlite3.connect(DB_FILE)
-        rows = conn.execute("SELECT timestamp, torque_value FROM torque_data").fetchall()
-        conn.close()
-        
-        if not rows:
+        report = exporters.pdf_report(**exporters.parse_filters(request.args))
+        if report is None:
             return jsonify({"error": "No data available for PDF export"}), 400
-        
-        with tempfile.NamedTemporaryFile(delete=False, suffix='.pdf') as tmp_file:
-            temp_path = tmp_file.name
-        
-        c = canvas.Canvas(temp_path)
-        c.drawString(100, 800, "Torque Sensor Report")
-        y = 780
-        for ts, v in rows:
-            c.drawString(100, y, f"{ts} – {v:.2f} N·cm")
-            y -= 15
-            if y < 50:
-                c.showPage()
-                y = 800
-        c.save()
-        
-        response = send_file(temp_path, as_attachment=True, download_name="torque_data.pdf")
-        response.call_on_close(lambda: os.unlink(temp_path))
-        return response
-        
+        return send_file(report, mimetype="application/pdf",
+                         as_attachment=True, download_name="torque_data.pdf")
+
     except ImportError:
         return jsonify({"error": "ReportLab library not installed. Install with: pip install reportlab"}), 500
     except Exception as e:
@@ -251,12 +419,8 @@ def export_pdf():
 
 @app.route("/start")
 def start_ble():
-    global ble_thread, stop_ble
     try:
-        if ble_thread is None or not ble_thread.is_alive():
-            stop_ble = False
-            ble_thread = threading.Thread(target=lambda: asyncio.run(ble_loop()), daemon=True)
-            ble_thread.start()
+        if ingest.start():
             return jsonify({"status": "BLE reader started"})
         else:
             return jsonify({"status": "BLE reader already running"})
@@ -265,31 +429,130 @@ def start_ble():
 
 @app.route("/stop")
 def stop_ble_connection():
-    global stop_ble
-    stop_ble = True
+    ingest.stop()
     return jsonify({"status": "BLE reader stopped"})
 
-if __name__ == "__main__":
-    init_db()
-    app.run(debug=True, host='0.0.0.0', port=5000)
-
 @app.route("/push", methods=["POST"])
 def push_data():
     """
-    Accept JSON { "torque_value": float, "timestamp": "ISO8601" }
+    Accept JSON { "raw": int counts, or "torque_value": float,
+    "timestamp": epoch µs or "ISO8601", "sensor_id": optional }.
+    A torque_value is converted back to counts with the calibration in force at its timestamp.
     """
+    arrival = torque_store.now_us()
     payload = request.get_json(force=True)
+    raw    = payload.get("raw")
     torque = payload.get("torque_value")
     ts     = payload.get("timestamp")
-    if torque is None or ts is None:
+    if (raw is None and torque is None) or ts is None:
         return jsonify({"error":"Missing fields"}), 400
 
-    # Save to DB
-    conn = sqlite3.connect(DB_FILE)
-    conn.execute(
-        "INSERT INTO torque_data (timestamp, torque_value) VALUES (?,?)",
-        (ts, torque)
+    try:
+        ts = torque_store.to_us(ts)
+    except ValueError:
+        return jsonify({"error":"Invalid timestamp"}), 400
+    sensor_id = payload.get("sensor_id", torque_store.DEFAULT_SENSOR)
+    try:
+        if raw is None:
+            raw = torque_store.current_calibration().to_raw(sensor_id, ts, float(torque))
+        raw = int(raw)
+    except (TypeError, ValueError, OverflowError):
+        return jsonify({"error":"Invalid raw/torque_value"}), 400
+    # Stored and analysed like BLE samples (live chart, spectrogram, alerts,
+    # cycles); latency is timed from our own arrival, not the client's clock
+    ingest.push(sensor_id, [ts], [raw], arrival, device_clock=PUSH_CLOCK_TRUSTED)
+    return jsonify({"status":"ok"}), 200
+
+# ── Cycles ──
+
+@app.route("/cycles")
+def get_cycles():
+    """
+    Tightening cycles starting in ?start&end, for ?sensor, with optional
+    ?min_peak / ?max_peak (N·cm); page with ?after=<last id> and ?limit (max 10000).
+    Includes stats over the returned cycles' final torque.
+    """
+    filters = exporters.parse_filters(request.args)
+    rows = torque_store.list_cycles(
+        filters["start"], filters["end"], filters["sensor_id"],
+        request.args.get("min_peak", type=float), request.args.get("max_peak", type=float),
+        request.args.get("after", 0, type=int),
+        min(request.args.get("limit", 1000, type=int), 10000),
     )
-    conn.commit()
-    conn.close()
-    return jsonify({"status":"ok"}), 200
\ No newline at end of file
+    return jsonify({
+        "cycles": rows,
+        "final_torque": stats.describe([r["final_torque"] for r in rows]),
+        "last_id": rows[-1]["id"] if rows else None,
+    })
+
+# ── Alerts ──
+
+@app.route("/alerts/rules", methods=["GET"])
+def get_alert_rules():
+    return jsonify({"rules": torque_store.list_alert_rules()})
+
+@app.route("/alerts/rules", methods=["POST"])
+def save_alert_rule():
+    """
+    Create or replace a rule by name: JSON { "name", "kind", "params",
+    "sensor_id": optional ("*" = all), "enabled": optional }. See alerts.py for kinds.
+    """
+    payload = request.get_json(force=True)
+    name, kind, params = payload.get("name"), payload.get("kind"), payload.get("params")
+    if not name or not isinstance(params, dict):
+        return jsonify({"error": "Missing fields"}), 400
+    try:
+        alerts.compile_rule(kind, params)
+    except alerts.RuleError as e:
+        return jsonify({"error": str(e)}), 400
+    rule_id = torque_store.save_alert_rule(name, kind, params,
+                                           payload.get("sensor_id", torque_store.ALL_SENSORS),
+                                           bool(payload.get("enabled", True)))
+    alert_engine.reload()
+    return jsonify({"status": "ok", "id": rule_id}), 200
+
+@app.route("/alerts/rules/<int:rule_id>", methods=["DELETE"])
+def delete_alert_rule(rule_id):
+    if not torque_store.delete_alert_rule(rule_id):
+        return jsonify({"error": "Unknown rule"}), 404
+    alert_engine.reload()
+    return jsonify({"status": "ok"}), 200
+
+@app.route("/alerts")
+def get_alerts():
+    """
+    Alert events with seq > ?after (default 0), plus the usual start/end/sensor
+    filters. ?wait=<seconds> (max 30) long-polls until a newer event exists.
+    """
+    after = request.args.get("after", 0, type=int)
+    filters = exporters.parse_filters(request.args)
+    wait = min(request.args.get("wait", 0, type=float), 30.0)
+    if wait > 0:
+        alert_engine.wait(after, wait)
+    events = torque_store.alert_events(after, filters["start"], filters["end"], filters["sensor_id"])
+    last = events[-1]["seq"] if events else max(after, 0)
+    return jsonify({"events": events, "last_seq": last})
+
+@app.route("/alerts/stream")
+def stream_alerts():
+    """Server-sent events: one "alert" event per raise / clear, from now on."""
+    def generate():
+        seq = alert_engine.last_seq
+        while True:
+            alert_engine.wait(seq, 15.0)
+            events = torque_store.alert_events(seq)
+            for event in events:
+                seq = event["seq"]
+                yield f"id: {seq}\nevent: alert\ndata: {json.dumps(event)}\n\n"
+            if not events:
+                yield ": keep-alive\n\n"
+
+    return Response(stream_with_context(generate()), mimetype="text/event-stream",
+                    headers={"Cache-Control": "no-cache"})
+
+if __name__ == "__main__":
+    init_db()
+    # The debug reloader runs this twice; only the serving child may bind the port
+    if LOCAL_INGEST_PORT and os.environ.get("WERKZEUG_RUN_MAIN") == "true":
+        ingest.listen_local(LOCAL_INGEST_PORT)
+    app.run(debug=True, host='0.0.0.0', port=5000)
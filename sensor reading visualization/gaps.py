@@ -0,0 +1,90 @@
+"""
+Loss accounting: turns missing frames into explicit "no data" intervals.
+
+When sensors prefix each notification frame with a little-endian sequence
+counter (config "sequenceBytes", 1-4 bytes, wrapping), every jump of more
+than one between consecutive frames of a sensor is a gap. It is stored in
+torque_store's data_gaps table as the interval between the last frame
+before it and the first frame after it, with the number of frames lost and
+an estimate of the samples they held. A dropped BLE link is recorded the
+same way (reason "link"), with or without sequence numbers.
+
+Charts and statistics read these intervals to tell "no torque" (samples at
+zero) apart from "no data" (a gap).
+"""
+
+import threading
+
+import numpy as np
+
+import metrics
+import torque_store
+
+REASON_SEQUENCE = "sequence"
+REASON_LINK = "link"
+
+
+class SequenceTracker:
+    """Per-sensor frame sequence state; check() is called by the ingest writer per batch."""
+
+    def __init__(self, seq_bytes):
+        if not 1 <= seq_bytes <= 4:
+            raise ValueError("seq_bytes must be 1 to 4")
+        self.seq_bytes = seq_bytes
+        self.modulus = 1 << (8 * seq_bytes)
+        self._last = {}  # sensor_id -> (seq, ts_us) of the newest frame
+        self._lock = threading.Lock()
+
+    def check(self, sensor_id, seqs, ts_us, per_frame):
+        """
+        One sensor's frames in arrival order: sequence numbers, arrival stamps
+        and samples per frame. Stores and returns the gaps found as rows.
+
+        A jump forward of up to half the counter range is a gap; a repeat is
+        a duplicate frame; anything else (a jump backwards) means the sensor
+        restarted its counter, which is counted but not treated as loss.
+        """
+        seqs = np.asarray(seqs, dtype=np.int64)
+        ts_us = np.asarray(ts_us, dtype=np.int64)
+        with self._lock:
+            last = self._last.get(sensor_id)
+            self._last[sensor_id] = (int(seqs[-1]), int(ts_us[-1]))
+        if last is None:
+            prev_seq = np.concatenate([[seqs[0] - 1], seqs[:-1]])
+            prev_ts = np.concatenate([[ts_us[0]], ts_us[:-1]])
+        else:
+            prev_seq = np.concatenate([[last[0]], seqs[:-1]])
+            prev_ts = np.concatenate([[last[1]], ts_us[:-1]])
+        step = (seqs - prev_seq) % self.modulus
+
+        duplicates = int(np.count_nonzero(step == 0))
+        restarts = int(np.count_nonzero(step > self.modulus // 2))
+        if duplicates:
+            metrics.DECODE_ERRORS.labels(sensor_id, "duplicate_frame").inc(duplicates)
+        if restarts:
+            metrics.DECODE_ERRORS.labels(sensor_id, "sequence_restart").inc(restarts)
+
+        gap = np.flatnonzero((step > 1) & (step <= self.modulus // 2))
+        if not len(gap):
+            return []
+        lost = step[gap] - 1
+        per_frame = np.asarray(per_frame, dtype=np.int64)
+        rows = [
+            (sensor_id, int(a), int(b), REASON_SEQUENCE, int(n), int(n * k))
+            for a, b, n, k in zip(prev_ts[gap].tolist(), ts_us[gap].tolist(),
+                                  lost.tolist(), per_frame[gap].tolist())
+        ]
+        torque_store.save_gaps(rows)
+        metrics.SEQUENCE_GAPS.labels(sensor_id).inc(len(rows))
+        metrics.LOST_FRAMES.labels(sensor_id).inc(int(lost.sum()))
+        return rows
+
+    def forget(self, sensor_id):
+        with self._lock:
+            self._last.pop(sensor_id, None)
+
+
+def link_gap(sensor_id, lost_us, restored_us):
+    """A sensor's link was down from lost_us to restored_us (epoch µs)."""
+    if restored_us > lost_us:
+        torque_store.save_gaps([(sensor_id, int(lost_us), int(restored_us), REASON_LINK, None, None)])
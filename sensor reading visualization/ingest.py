@@ -0,0 +1,661 @@
+"""
+Multi-sensor BLE ingestion.
+Every advertising device that matches the configured service UUID, name or
+manufacturer gets its own reconnecting worker task; all workers feed one
+writer thread that commits samples to torque_store in batches.
+
+The scanner and the workers are tasks on the shared ble_loop event loop;
+no thread is started per sensor or per /start. A worker is a state
+machine (CONNECTING -> SUBSCRIBING -> STREAMING -> BACKOFF -> CONNECTING,
+STOPPED on stop()) with one coroutine per state returning the next.
+
+Sensors that streamed before are remembered in torque_store's ble_devices
+table: address, address type and the torque characteristic's GATT handle.
+On start() they are connected straight away, without waiting for the
+scanner. Subscribing uses the cached handle and walks the services only
+when the handle fails.
+
+Sensors can also be fed without a radio over a local UDP socket (load
+generators, sensor stand-ins): each datagram is one notification frame
+prefixed with its sensor id, see pack_local().
+"""
+
+import asyncio
+import platform
+import queue
+import socket
+import threading
+import time
+from collections import Counter, deque
+from types import SimpleNamespace
+
+import numpy as np
+from bleak import BleakScanner
+from bleak.backends.device import BLEDevice
+from bleak.backends.scanner import AdvertisementData
+
+import ble_loop
+import clock
+import decoder
+import gaps
+import metrics
+import spectrum
+from ring import SampleRing
+import torque_store
+
+# On Linux, force the random-address client
+if platform.system() == "Linux":
+    from bleak.backends.bluezdbus import BlueZClient as BLEClient, AddressType
+else:
+    from bleak import BleakClient as BLEClient
+    AddressType = None
+
+RECONNECT_MIN_S = 1.0
+RECONNECT_MAX_S = 30.0
+WRITE_BATCH_MAX = 1000   # queued frames per transaction, not samples: a frame holds a whole notification
+WRITE_FLUSH_S = 0.25     # max time a frame waits in the queue
+STAGES = ("queue", "decode", "analytics", "store")
+STAGE_HISTORY = 10000    # batches kept per stage for percentiles
+LOCAL_HOST = "127.0.0.1"
+LOCAL_RCVBUF = 8 << 20   # socket buffer, so bursts are not dropped by the kernel
+RECENT_S = 60.0          # calibrated samples kept in memory per sensor ...
+RECENT_HZ = 1000.0       # ... at up to this rate (RECENT_S * RECENT_HZ slots)
+
+# Connection states of a sensor worker
+CONNECTING = "connecting"
+SUBSCRIBING = "subscribing"
+STREAMING = "streaming"
+BACKOFF = "backoff"
+STOPPED = "stopped"
+
+
+def pack_local(sensor_id, frame):
+    """Datagram for the local transport: id length byte, UTF-8 sensor id, frame bytes."""
+    sid = sensor_id.encode("utf-8")
+    return bytes([len(sid)]) + sid + frame
+
+
+def unpack_local(datagram):
+    """Inverse of pack_local(): (sensor_id, frame), or None if malformed."""
+    n = datagram[0] if datagram else 0
+    if not n or len(datagram) < 1 + n + decoder.SAMPLE_BYTES:
+        return None
+    return datagram[1:1 + n].decode("utf-8", "replace"), datagram[1 + n:]
+
+
+class StageTimes:
+    """Per-batch durations of each writer stage, for latency reports."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self._lock:
+            self._durations = {stage: deque(maxlen=STAGE_HISTORY) for stage in STAGES}
+            self.batches = 0
+            self.samples = 0
+
+    def record(self, samples, **durations):
+        with self._lock:
+            self.batches += 1
+            self.samples += samples
+            for stage, seconds in durations.items():
+                self._durations[stage].append(seconds)
+
+    def summary(self):
+        """{stage: {mean_ms, p50_ms, p95_ms, p99_ms, max_ms}} over the kept batches."""
+        with self._lock:
+            durations = {stage: np.array(d) for stage, d in self._durations.items()}
+        result = {}
+        for stage, d in durations.items():
+            if not len(d):
+                continue
+            p50, p95, p99 = np.percentile(d, [50, 95, 99]) * 1e3
+            result[stage] = {"mean_ms": float(d.mean() * 1e3), "p50_ms": float(p50),
+                             "p95_ms": float(p95), "p99_ms": float(p99),
+                             "max_ms": float(d.max() * 1e3)}
+        return result
+
+
+class SensorLink:
+    """
+    Connection state of one sensor. Owned by its worker task, except the
+    sample counters and spectrogram, which the writer thread updates after
+    each batch.
+    """
+
+    def __init__(self, device, address_type=None, char_handle=None):
+        self.device = device
+        self.sensor_id = device.address
+        self.name = device.name
+        self.address_type = address_type  # "public" / "random"; None = unknown (random is tried)
+        self.char_handle = char_handle    # cached GATT handle of the torque characteristic
+        self.status = "Discovered"
+        self.state = CONNECTING
+        self.client = None
+        self.wake = None  # asyncio.Event: link dropped or stop() called
+        self.connected = False
+        self.samples = 0
+        self.reconnects = 0
+        self.backoff = RECONNECT_MIN_S
+        self.last_torque = None
+        self.lost_at = None  # (monotonic, epoch µs) the link dropped, until it streams again
+        self.spectrum = spectrum.Spectrogram()
+        self.recent = None  # SampleRing of calibrated samples, made by the writer on first data
+        self.task = None
+
+    def as_dict(self):
+        status = self.status
+        if self.connected and self.last_torque is not None:
+            status = f"Streaming: {self.last_torque:.2f} N·cm"
+        return {
+            "sensor_id": self.sensor_id,
+            "name": self.name,
+            "status": status,
+            "state": self.state,
+            "connected": self.connected,
+            "cached_handle": self.char_handle,
+            "samples": self.samples,
+            "reconnects": self.reconnects,
+            "last_torque": self.last_torque,
+        }
+
+
+class IngestManager:
+    def __init__(self, service_uuid, torque_uuid, sensor_name, manufacturer_name,
+                 sample_stride=decoder.SAMPLE_BYTES, alerts=None, cycles=None, latency=None,
+                 seq_bytes=0, tick_bytes=0, tick_hz=32768, sample_ticks=None,
+                 recent_s=RECENT_S, recent_hz=RECENT_HZ):
+        self.service_uuid = service_uuid.lower()
+        self.torque_uuid = torque_uuid
+        self.sensor_name = sensor_name.lower()
+        self.manufacturer_name = manufacturer_name
+        self.sample_stride = sample_stride  # bytes per sample in a notification frame
+        # Frame header: a seq_bytes sequence counter (gaps in it are stored as loss),
+        # then a tick_bytes device tick counter at tick_hz for the first sample
+        # (samples are then timestamped from the device clock, see clock.py)
+        self.seq_bytes = seq_bytes
+        self.tick_bytes = tick_bytes
+        self.header = seq_bytes + tick_bytes
+        self.sequence = gaps.SequenceTracker(seq_bytes) if seq_bytes else None
+        self.clocks = clock.ClockBank(tick_hz, tick_bytes, sample_ticks) if tick_bytes else None
+        self.alerts = alerts  # alerts.AlertEngine run over every decoded sample, if set
+        self.cycles = cycles  # cycles.CycleTracker segmenting every sensor, if set
+        self.latency = latency  # latency.LatencyTracker timing received -> stored, if set
+        self.recent_s = recent_s
+        self.recent_hz = recent_hz
+
+        self.links = {}  # address -> SensorLink
+        self.stage_times = StageTimes()
+        self._scan_status = "Disconnected"
+        self._stop = False
+        self._task = None  # concurrent.futures.Future of _run() on the shared loop
+        self._wake = None  # asyncio.Event set by stop()
+        self._writer = None
+        self._local = None  # UDP socket of the local transport, if listening
+        self._queue = queue.Queue()
+        self._commit_lock = threading.Lock()  # one batch analysed and stored at a time
+
+    # ── Control (called from Flask threads) ──
+
+    def start(self):
+        """Start scanning/ingesting. Returns False if already running."""
+        if self._task is not None and not self._task.done():
+            return False
+        self._stop = False
+        self.start_writer()
+        self._task = ble_loop.submit(self._run())
+        return True
+
+    def stop(self):
+        self._stop = True
+        if self._task is not None and not self._task.done():
+            ble_loop.call_soon(self._wake_all)
+
+    def _wake_all(self):
+        for event in [self._wake] + [link.wake for link in self.links.values()]:
+            if event is not None:
+                event.set()
+
+    # ── External sources (replay, load generators) ──
+
+    def start_writer(self):
+        """Start the storage writer on its own, for sources that call feed()."""
+        if self._writer is None or not self._writer.is_alive():
+            self._writer = threading.Thread(target=self._writer_loop, daemon=True)
+            self._writer.start()
+
+    def attach(self, sensor_id, name=None):
+        """Register a sensor that is fed through feed() rather than BLE."""
+        link = self.links.get(sensor_id)
+        if link is None:
+            link = SensorLink(SimpleNamespace(address=sensor_id, name=name or sensor_id))
+            link.connected = True
+            link.status = "Attached"
+            self.links[sensor_id] = link
+        return link
+
+    def feed(self, sensor_id, frame, ts_us=None):
+        """Queue one notification frame exactly as the BLE handler would."""
+        self._queue.put((torque_store.now_us() if ts_us is None else ts_us,
+                         frame, sensor_id, time.perf_counter()))
+
+    def push(self, sensor_id, ts_us, raw, arrival_us, device_clock=False):
+        """
+        Analyse and store already decoded samples (raw counts at epoch µs
+        ts_us), e.g. from HTTP /push, on the caller's thread: the same
+        recent ring, spectrogram, alerts, cycles and latency path the writer
+        takes for frames. device_clock marks ts_us as trusted device stamps.
+        """
+        self.attach(sensor_id)
+        stamps = np.asarray(ts_us, dtype=np.int64)
+        self._commit(stamps, np.full(len(stamps), arrival_us, dtype=np.int64),
+                     np.asarray(raw, dtype=np.int64), np.full(len(stamps), sensor_id, dtype=object),
+                     device_clock)
+
+    def backlog(self):
+        """Frames queued but not yet written."""
+        return self._queue.qsize()
+
+    def listen_local(self, port, host=LOCAL_HOST):
+        """
+        Accept frames from pack_local() datagrams on host:port. Unknown sensor
+        ids are attached on their first frame. Returns the bound port.
+        """
+        if self._local is not None:
+            return self._local.getsockname()[1]
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, LOCAL_RCVBUF)
+        sock.bind((host, port))
+        self._local = sock
+        self.start_writer()
+        threading.Thread(target=self._local_loop, args=(sock,), daemon=True).start()
+        return sock.getsockname()[1]
+
+    def _local_loop(self, sock):
+        put = self._queue.put
+        recv = sock.recv
+        attached = set()
+        while True:
+            try:
+                datagram = recv(65535)
+            except OSError:
+                return
+            item = unpack_local(datagram)
+            if item is None:
+                metrics.DECODE_ERRORS.labels("unknown", "malformed_datagram").inc()
+                continue
+            sensor_id, frame = item
+            if sensor_id not in attached:
+                self.attach(sensor_id)
+                attached.add(sensor_id)
+            put((torque_store.now_us(), frame, sensor_id, time.perf_counter()))
+
+    def drain(self):
+        """Stop accepting BLE data, flush everything queued and wait for the writer."""
+        self.stop()
+        if self._writer is not None and self._writer.is_alive():
+            self._queue.put(None)
+            self._writer.join()
+
+    @property
+    def status(self):
+        streaming = sum(1 for link in self.links.values() if link.connected)
+        if not self.links:
+            return self._scan_status
+        return f"{self._scan_status} · {streaming}/{len(self.links)} sensors streaming"
+
+    def sensors(self):
+        return [link.as_dict() for link in list(self.links.values())]
+
+    def recent(self, sensor_id=None, seconds=None, since_us=None):
+        """
+        {sensor_id: (ts_us, torque)} from the in-memory rings: the last
+        `seconds` before each sensor's newest sample, or everything at or
+        after since_us, or all that is held.
+        """
+        links = [self.links.get(sensor_id)] if sensor_id else list(self.links.values())
+        result = {}
+        for link in links:
+            if link is None or link.recent is None:
+                continue
+            if seconds is not None:
+                result[link.sensor_id] = link.recent.window(seconds)
+            else:
+                result[link.sensor_id] = link.recent.since(since_us)
+        return result
+
+    def spectrogram(self, sensor_id=None):
+        """A sensor's Spectrogram; sensor_id may be omitted when only one is known."""
+        if sensor_id is None:
+            links = list(self.links.values())
+            return links[0].spectrum if len(links) == 1 else None
+        link = self.links.get(sensor_id)
+        return link.spectrum if link else None
+
+    # ── Discovery ──
+
+    def _matches(self, device: BLEDevice, adv: AdvertisementData):
+        return (adv.service_uuids and self.service_uuid in [u.lower() for u in adv.service_uuids]) or \
+               (device.name and self.sensor_name in device.name.lower()) or \
+               (adv.manufacturer_data and self.manufacturer_name in str(adv.manufacturer_data))
+
+    def _on_detect(self, device: BLEDevice, adv: AdvertisementData):
+        if self._stop or not self._matches(device, adv):
+            return
+        link = self.links.get(device.address)
+        if link is None:
+            link = SensorLink(device)
+            self.links[device.address] = link
+        else:
+            # Keep the freshest BLEDevice handle for the next reconnect
+            link.device = device
+        details = getattr(device, "details", None)
+        if isinstance(details, dict):  # BlueZ reports the address type with the device
+            link.address_type = details.get("props", {}).get("AddressType", link.address_type)
+        self._spawn(link)
+
+    def _spawn(self, link):
+        if link.task is None or link.task.done():
+            link.state = CONNECTING
+            link.task = asyncio.get_running_loop().create_task(self._sensor_worker(link))
+
+    def _restore_known(self):
+        """Connect to every cached device at once, without waiting for an advertisement."""
+        for known in torque_store.list_devices():
+            if known["service_uuid"] not in (None, self.service_uuid):
+                continue
+            link = self.links.get(known["sensor_id"])
+            if link is None:
+                device = SimpleNamespace(address=known["sensor_id"], name=known["name"])
+                link = SensorLink(device, known["address_type"], known["char_handle"])
+                link.status = "Known device"
+                self.links[link.sensor_id] = link
+            self._spawn(link)
+
+    async def _run(self):
+        self._scan_status = "Scanning…"
+        self._wake = asyncio.Event()
+        try:
+            self._restore_known()
+        except Exception as e:
+            print(f"Device cache not loaded: {str(e)}")
+        scanner = BleakScanner(self._on_detect)
+        try:
+            await scanner.start()
+            if not self._stop:
+                await self._wake.wait()
+        except Exception as e:
+            self._scan_status = f"Scanner error: {str(e)}"
+        finally:
+            await scanner.stop()
+            self._wake_all()
+            tasks = [link.task for link in self.links.values() if link.task]
+            await asyncio.gather(*tasks, return_exceptions=True)
+            self._scan_status = "Disconnected"
+
+    # ── Per-sensor worker (connection state machine) ──
+
+    async def _sensor_worker(self, link: SensorLink):
+        steps = {CONNECTING: self._connect, SUBSCRIBING: self._subscribe,
+                 STREAMING: self._streaming, BACKOFF: self._backoff}
+        link.wake = asyncio.Event()
+        while link.state != STOPPED:
+            if self._stop:
+                link.state = STOPPED
+                break
+            try:
+                link.state = await steps[link.state](link)
+            except Exception as e:
+                link.status = f"BLE Error: {str(e)}"
+                link.state = BACKOFF
+        await self._disconnect(link)
+        link.connected = False
+        link.status = "Disconnected"
+
+    async def _connect(self, link):
+        link.wake.clear()
+
+        def on_disconnect(_client):
+            link.wake.set()
+
+        if platform.system() == "Linux":
+            address_type = getattr(AddressType, link.address_type or "random", AddressType.random)
+            link.client = BLEClient(link.device.address, address_type=address_type,
+                                    disconnected_callback=on_disconnect)
+        else:
+            # A cached device is only its address until a scan sees it again;
+            # BleakClient takes a BLEDevice or an address string
+            target = link.device if isinstance(link.device, BLEDevice) else link.device.address
+            link.client = BLEClient(target, disconnected_callback=on_disconnect)
+        link.status = "Connecting…"
+        await link.client.connect()
+        if not link.client.is_connected:
+            link.status = "Connection failed"
+            return BACKOFF
+        return SUBSCRIBING
+
+    async def _subscribe(self, link):
+        handler = self._make_handler(link)
+        subscribed = False
+        if link.char_handle is not None:
+            try:
+                await link.client.start_notify(link.char_handle, handler)
+                subscribed = True
+            except Exception:
+                link.char_handle = None  # firmware changed the GATT table: discover again
+
+        if not subscribed:
+            metrics.GATT_DISCOVERIES.labels(link.sensor_id).inc()
+            services = await link.client.get_services()
+            if not any(s.uuid.lower() == self.service_uuid for s in services):
+                link.status = "Required service not found"
+                return BACKOFF
+            characteristic = services.get_characteristic(self.torque_uuid)
+            await link.client.start_notify(characteristic or self.torque_uuid, handler)
+            link.char_handle = characteristic.handle if characteristic is not None else None
+            torque_store.save_device(link.sensor_id, link.name, link.address_type,
+                                     self.service_uuid, self.torque_uuid, link.char_handle)
+        link.connected = True
+        link.backoff = RECONNECT_MIN_S
+        if link.lost_at is not None:
+            lost_mono, lost_us = link.lost_at
+            metrics.RECONNECT_SECONDS.labels(link.sensor_id).observe(time.monotonic() - lost_mono)
+            gaps.link_gap(link.sensor_id, lost_us, torque_store.now_us())
+            link.lost_at = None
+        link.status = "Connected ✓"
+        return STREAMING
+
+    async def _streaming(self, link):
+        # Notifications arrive through the handler; wait for the link to drop or stop()
+        if link.client.is_connected and not self._stop:
+            await link.wake.wait()
+        if self._stop:
+            return STOPPED
+        link.status = "Connection lost"
+        return BACKOFF
+
+    async def _backoff(self, link):
+        await self._disconnect(link)
+        if link.connected:
+            link.lost_at = (time.monotonic(), torque_store.now_us())
+        link.connected = False
+        link.reconnects += 1
+        metrics.RECONNECTS.labels(link.sensor_id).inc()
+        link.wake.clear()
+        try:
+            # Sleeps through the backoff, unless stop() wakes the link first
+            await asyncio.wait_for(link.wake.wait(), link.backoff)
+        except asyncio.TimeoutError:
+            pass
+        link.backoff = min(link.backoff * 2, RECONNECT_MAX_S)
+        return CONNECTING
+
+    async def _disconnect(self, link):
+        client, link.client = link.client, None
+        if client is None:
+            return
+        try:
+            if client.is_connected:
+                await client.stop_notify(link.char_handle if link.char_handle is not None else self.torque_uuid)
+            await client.disconnect()
+        except Exception:
+            pass  # the link is being dropped either way
+
+    def _make_handler(self, link: SensorLink):
+        put = self._queue.put
+        sensor_id = link.sensor_id
+        short_frames = metrics.DECODE_ERRORS.labels(sensor_id, "short_frame")
+        min_length = self.header + decoder.SAMPLE_BYTES
+
+        def notification_handler(sender, data):
+            # Frames hold one or more packed 24-bit samples; decoding happens
+            # in batches on the writer thread, so only stamp and queue here
+            if len(data) < min_length:
+                link.status = f"Unexpected notification data length: {len(data)} bytes (expected at least {min_length})"
+                short_frames.inc()
+                return
+            put((torque_store.now_us(), bytes(data), sensor_id, time.perf_counter()))
+
+        return notification_handler
+
+    # ── Storage writer ──
+
+    def _process_batch(self, batch):
+        """Decode, analyse and store queued (ts_us, frame, sensor_id, enqueued) notifications."""
+        t0 = time.perf_counter()
+        stamps, frames, sensors, enqueued = zip(*batch)
+        self._count_frames(frames, sensors)
+        if self.header and min(map(len, frames)) < self.header + decoder.SAMPLE_BYTES:
+            # Only the local transport can deliver these; the BLE handler rejects them
+            keep = [i for i, f in enumerate(frames) if len(f) >= self.header + decoder.SAMPLE_BYTES]
+            stamps, frames, sensors = ([col[i] for i in keep] for col in (stamps, frames, sensors))
+            if not keep:
+                return
+        counts, per_frame = decoder.unpack_frames(frames, self.sample_stride, self.header)
+        if self.sequence is not None:
+            self._check_sequences(frames, stamps, sensors, per_frame)
+        arrivals = np.repeat(np.array(stamps, dtype=np.int64), per_frame)
+        if self.clocks is not None:
+            stamps = self._device_stamps(frames, stamps, sensors, per_frame)
+        else:
+            # Samples packed into one frame share its arrival time
+            stamps = arrivals
+        sensors = np.repeat(np.array(sensors, dtype=object), per_frame)
+        t1 = time.perf_counter()
+        durations = {"queue": t0 - min(enqueued), "decode": t1 - t0,
+                     **self._commit(stamps, arrivals, counts, sensors, self.clocks is not None)}
+        self.stage_times.record(len(counts), **durations)
+        metrics.BATCH_SAMPLES.observe(len(counts))
+        for stage, seconds in durations.items():
+            metrics.STAGE_SECONDS.labels(stage).observe(seconds)
+
+    def _commit(self, stamps, arrivals, counts, sensors, device_clock):
+        """Analyse and store decoded samples; returns the analytics / store stage seconds."""
+        with self._commit_lock:
+            t1 = time.perf_counter()
+            newest = self._analyse(stamps, arrivals, counts, sensors)
+            t2 = time.perf_counter()
+            torque_store.save_batch(list(zip(stamps.tolist(), counts.tolist(), sensors.tolist())))
+            t3 = time.perf_counter()
+            if self.latency is not None:
+                self.latency.stored(arrivals, torque_store.now_us(), newest,
+                                    stamps if device_clock else None)
+        return {"analytics": t2 - t1, "store": t3 - t2}
+
+    def _check_sequences(self, frames, stamps, sensors, per_frame):
+        """Record gaps in each sensor's frame sequence numbers."""
+        seqs = decoder.read_header(frames, 0, self.seq_bytes).astype(np.int64)
+        stamps = np.asarray(stamps, dtype=np.int64)
+        sensors = np.array(sensors, dtype=object)
+        for sensor_id in set(sensors.tolist()):
+            idx = np.flatnonzero(sensors == sensor_id)
+            self.sequence.check(sensor_id, seqs[idx], stamps[idx], per_frame[idx])
+
+    def _device_stamps(self, frames, arrivals, sensors, per_frame):
+        """Per-sample timestamps from each sensor's device clock fit, in batch order."""
+        ticks = decoder.read_header(frames, self.seq_bytes, self.tick_bytes).astype(np.int64)
+        arrivals = np.asarray(arrivals, dtype=np.int64)
+        frame_sensors = np.array(sensors, dtype=object)
+        sample_sensors = np.repeat(frame_sensors, per_frame)
+        stamps = np.empty(len(sample_sensors), dtype=np.int64)
+        for sensor_id in set(frame_sensors.tolist()):
+            idx = np.flatnonzero(frame_sensors == sensor_id)
+            # A sensor's frames are in order, so its samples are too
+            stamps[sample_sensors == sensor_id] = self.clocks.timestamps(
+                sensor_id, ticks[idx], arrivals[idx], per_frame[idx])
+        return stamps
+
+    def _count_frames(self, frames, sensors):
+        """Frame counters per sensor, and frames ending in a truncated sample."""
+        lengths = np.fromiter(map(len, frames), dtype=np.int64, count=len(frames))
+        stray = decoder.stray_bytes(np.maximum(lengths - self.header, 0), self.sample_stride) > 0
+        for sensor_id, n in Counter(sensors).items():
+            metrics.FRAMES.labels(sensor_id).inc(n)
+        if stray.any():
+            for sensor_id, n in Counter(s for s, bad in zip(sensors, stray.tolist()) if bad).items():
+                metrics.DECODE_ERRORS.labels(sensor_id, "truncated_sample").inc(n)
+
+    def _analyse(self, stamps, arrivals, counts, sensors):
+        """
+        Live readout, recent ring, spectrogram, alerts and cycles per sensor,
+        on values calibrated with the versions in force at their timestamps
+        (re-read after every POST /calibration). Returns {sensor_id: (newest
+        stamp, its arrival)} for the batch.
+        """
+        calibration = torque_store.current_calibration()
+        newest = {}
+        for sensor_id in set(sensors.tolist()):
+            idx = np.flatnonzero(sensors == sensor_id)
+            newest[sensor_id] = (int(stamps[idx[-1]]), int(arrivals[idx[-1]]))
+            link = self.links.get(sensor_id)
+            if link is None:
+                continue
+            torque = decoder.calibrate(counts[idx], *calibration.params(sensor_id, stamps[idx]))
+            link.samples += len(idx)
+            metrics.SAMPLES.labels(sensor_id).inc(len(idx))
+            link.last_torque = float(torque[-1])
+            if link.recent is None:
+                link.recent = SampleRing.for_window(self.recent_s, self.recent_hz)
+            link.recent.extend(stamps[idx], torque)
+            link.spectrum.add(stamps[idx], torque)
+            if self.alerts is not None:
+                self.alerts.evaluate(sensor_id, stamps[idx], torque)
+            if self.cycles is not None:
+                self.cycles.feed(sensor_id, stamps[idx], torque)
+        return newest
+
+    def _writer_loop(self):
+        """Drain the sample queue into the store, one transaction per batch."""
+        get = self._queue.get
+        closing = False
+        while not closing:
+            try:
+                item = get(timeout=WRITE_FLUSH_S)
+            except queue.Empty:
+                if self._stop and self._local is None and \
+                        (self._task is None or self._task.done()):
+                    return
+                continue
+            if item is None:  # drain(): nothing is queued behind it
+                return
+            batch = [item]
+            deadline = time.monotonic() + WRITE_FLUSH_S
+            while len(batch) < WRITE_BATCH_MAX:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                try:
+                    item = get(timeout=remaining)
+                except queue.Empty:
+                    break
+                if item is None:
+                    closing = True
+                    break
+                batch.append(item)
+            try:
+                self._process_batch(batch)
+            except Exception as e:
+                metrics.DROPPED_FRAMES.inc(len(batch))
+                print(f"Store write failed, dropped {len(batch)} frames: {str(e)}")
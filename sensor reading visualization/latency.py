@@ -0,0 +1,132 @@
+"""
+End-to-end latency of torque samples, from sensor to screen.
+
+A sample passes these checkpoints, each an epoch µs stamp:
+
+  device     sampled on the sensor (only when frames carry a device clock)
+  received   notification arrived on the host (the stored ts_us)
+  stored     its batch committed to torque_store
+  served     returned by /torque
+  rendered   drawn by the dashboard (reported back via POST /latency)
+
+Each hop between consecutive checkpoints has a histogram with log-spaced
+buckets, so recording is one bincount per batch and the memory is fixed.
+"end_to_end" is the age of a sample when it is rendered: from device
+when known, otherwise from received.
+"""
+
+import threading
+
+import numpy as np
+
+CHECKPOINTS = ("device", "received", "stored", "served", "rendered")
+HOPS = tuple(f"{a}_{b}" for a, b in zip(CHECKPOINTS[:-1], CHECKPOINTS[1:])) + ("end_to_end",)
+
+BUCKETS_PER_DECADE = 10
+MIN_US = 10               # first bucket edge; faster goes into the underflow bucket
+MAX_US = 100_000_000      # 100 s; slower goes into the overflow bucket
+EDGES_US = np.logspace(np.log10(MIN_US), np.log10(MAX_US),
+                       BUCKETS_PER_DECADE * int(round(np.log10(MAX_US / MIN_US))) + 1)
+
+
+class LatencyHistogram:
+    """Counts of durations (µs) in EDGES_US buckets, plus underflow and overflow."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self._lock:
+            self.counts = np.zeros(len(EDGES_US) + 1, dtype=np.int64)
+            self.total_us = 0.0
+            self.max_us = 0.0
+
+    def add(self, durations_us):
+        d = np.asarray(durations_us, dtype=np.float64).ravel()
+        if not len(d):
+            return
+        # Clock steps can make a hop look negative; count it as zero
+        d = np.maximum(d, 0.0)
+        bins = np.bincount(np.searchsorted(EDGES_US, d, side="right"), minlength=len(self.counts))
+        with self._lock:
+            self.counts += bins
+            self.total_us += float(d.sum())
+            self.max_us = max(self.max_us, float(d.max()))
+
+    def quantile(self, q, counts=None):
+        """
+        Upper edge (µs) of the bucket holding quantile q, capped at the
+        largest value seen: an upper bound, exact to within one bucket.
+        """
+        counts = self.counts if counts is None else counts
+        n = counts.sum()
+        if not n:
+            return None
+        i = int(np.searchsorted(np.cumsum(counts), q * n, side="left"))
+        return min(float(EDGES_US[i]), self.max_us) if i < len(EDGES_US) else self.max_us
+
+    def summary(self):
+        """dict(count, mean_ms, p50_ms, p95_ms, p99_ms, max_ms, buckets) or None if empty."""
+        with self._lock:
+            counts = self.counts.copy()
+            total, top = self.total_us, self.max_us
+        n = int(counts.sum())
+        if not n:
+            return None
+        nonzero = np.flatnonzero(counts)
+        upper = np.append(EDGES_US, np.inf)
+        return {
+            "count": n,
+            "mean_ms": total / n / 1e3,
+            "p50_ms": self.quantile(0.50, counts) / 1e3,
+            "p95_ms": self.quantile(0.95, counts) / 1e3,
+            "p99_ms": self.quantile(0.99, counts) / 1e3,
+            "max_ms": top / 1e3,
+            # [upper bound ms (null = overflow), count] for every non-empty bucket
+            "buckets": [[None if np.isinf(upper[i]) else round(float(upper[i]) / 1e3, 4), int(counts[i])]
+                        for i in nonzero],
+        }
+
+
+class LatencyTracker:
+    """A histogram per hop, plus the checkpoints of each sensor's newest sample."""
+
+    def __init__(self):
+        self.hops = {hop: LatencyHistogram() for hop in HOPS}
+        self._stored = {}  # sensor_id -> (ts_us, received_us, stored_us, device clocked)
+
+    def record(self, hop, durations_us):
+        self.hops[hop].add(durations_us)
+
+    def stored(self, received_us, stored_us, newest, device_us=None):
+        """
+        A batch was committed at stored_us. received_us are its samples'
+        arrival times and device_us their device-clock timestamps, if frames
+        carry one; newest maps each sensor to (stored ts_us, arrival) of its
+        newest sample.
+        """
+        received_us = np.asarray(received_us, dtype=np.int64)
+        self.hops["received_stored"].add(stored_us - received_us)
+        if device_us is not None:
+            self.hops["device_received"].add(received_us - np.asarray(device_us, dtype=np.int64))
+        for sensor_id, (ts, received) in newest.items():
+            self._stored[sensor_id] = (ts, received, stored_us, device_us is not None)
+
+    def checkpoints(self, ts_us):
+        """
+        dict(device_us, received_us, stored_us) for the sample stored as
+        ts_us if it is a sensor's newest, else just received_us = ts_us.
+        """
+        for ts, received, stored_us, device in list(self._stored.values()):
+            if ts == ts_us:
+                return {"device_us": ts if device else None, "received_us": received,
+                        "stored_us": stored_us}
+        return {"device_us": None, "received_us": ts_us, "stored_us": None}
+
+    def reset(self):
+        for histogram in self.hops.values():
+            histogram.reset()
+
+    def summary(self):
+        return {hop: s for hop, s in ((h, hist.summary()) for h, hist in self.hops.items()) if s}
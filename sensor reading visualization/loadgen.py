@@ -0,0 +1,318 @@
+"""
+Synthetic load generator: N simulated torque sensors for sizing and
+saturation tests, no radios needed.
+
+Each simulated sensor produces tightening cycles plus a noise profile as raw
+24-bit counts, packed into notification frames of --frame-samples samples,
+with an optional dropout pattern (bursts of lost frames). With
+--seq-bytes each frame starts with a wrapping sequence counter, so the
+host can account for the dropped frames, and with --tick-bytes it then
+carries the device tick of its first sample, from a clock running
+--drift-ppm off nominal. Frames go either
+to a running final4.py over its local UDP transport (set "localIngestPort"
+in config.json) or, with --in-process, straight into an IngestManager
+writing to a scratch database, which also reports per-stage latency.
+
+    python loadgen.py --sensors 8 --rate 500 --port 5005 --server http://127.0.0.1:5000
+    python loadgen.py --sensors 32 --rate 1000 --in-process
+    python loadgen.py --sensors 16 --rate 0 --in-process      # as fast as possible
+"""
+
+import argparse
+import json
+import socket
+import time
+import urllib.request
+
+import numpy as np
+
+import ingest
+import torque_store
+from replay import build_manager, load_config, MAX_BACKLOG
+
+NOISE_PROFILES = ("none", "white", "pink", "spikes")
+CHUNK_S = 0.1         # signal generated per sensor per step
+SPIKE_PROB = 1e-3     # per sample, "spikes" profile
+SPIKE_GAIN = 10.0     # spike height relative to the noise level
+COUNT_MIN, COUNT_MAX = -(1 << 23), (1 << 23) - 1
+
+
+class SimSensor:
+    """One simulated sensor: a tightening-cycle signal, noise and dropouts, as raw counts."""
+
+    # Cycle shape over one period: ramp to peak, short overshoot, hold, release, idle
+    SHAPE_PHASE = [0.0, 0.30, 0.33, 0.50, 0.55, 1.0]
+    SHAPE_LEVEL = [0.0, 1.00, 0.92, 0.92, 0.00, 0.0]
+
+    def __init__(self, sensor_id, rate_hz, offset, scale, peak=20.0, cycle_s=2.0,
+                 noise="white", noise_level=0.05, drop_prob=0.0, drop_burst=1.0, seed=None,
+                 seq_bytes=0, tick_bytes=0, tick_hz=32768, drift_ppm=0.0):
+        if noise not in NOISE_PROFILES:
+            raise ValueError(f"noise must be one of {', '.join(NOISE_PROFILES)}")
+        self.sensor_id = sensor_id
+        self.rate_hz = rate_hz
+        self.offset = offset
+        self.scale = scale
+        self.peak = peak
+        self.cycle_s = cycle_s
+        self.noise = noise
+        self.noise_level = noise_level
+        self.drop_prob = drop_prob
+        self.drop_burst = max(drop_burst, 1.0)
+        self.seq_bytes = seq_bytes
+        self._seq = 0  # next frame's sequence number, dropped frames included
+        self.tick_bytes = tick_bytes
+        # Device ticks per sample: nominal tick_hz / rate_hz as measured by a drifting crystal
+        self._ticks_per_sample = tick_hz / rate_hz * (1 + drift_ppm * 1e-6)
+        self._rng = np.random.default_rng(seed)
+        self._phase0 = self._rng.random()  # sensors do not tighten in lockstep
+        self._n = 0           # samples generated so far
+        self._drop_left = 0   # frames still to drop from a burst crossing chunks
+
+    def counts(self, n):
+        """Next n samples as int64 counts."""
+        t = (self._n + np.arange(n)) / self.rate_hz
+        self._n += n
+        phase = (t / self.cycle_s + self._phase0) % 1.0
+        cycle = np.floor(t / self.cycle_s + self._phase0)
+        # Peak varies a little from cycle to cycle
+        peak = self.peak * (1 + 0.03 * np.sin(cycle * 2.39996))
+        torque = np.interp(phase, self.SHAPE_PHASE, self.SHAPE_LEVEL) * peak + self._noise(n)
+        return np.clip(np.round(torque / self.scale + self.offset), COUNT_MIN, COUNT_MAX).astype(np.int64)
+
+    def _noise(self, n):
+        if self.noise == "none" or not self.noise_level:
+            return 0.0
+        white = self._rng.standard_normal(n)
+        if self.noise == "pink":
+            # Shape white noise to 1/f power, then restore unit variance
+            spectrum = np.fft.rfft(white)
+            spectrum[1:] /= np.sqrt(np.arange(1, len(spectrum)))
+            white = np.fft.irfft(spectrum, n)
+            white /= white.std() or 1.0
+        elif self.noise == "spikes":
+            spikes = self._rng.random(n) < SPIKE_PROB
+            white = white + spikes * SPIKE_GAIN * self._rng.choice([-1.0, 1.0], n)
+        return white * self.noise_level
+
+    def dropped(self, n_frames):
+        """Boolean mask of frames lost in transit: bursts start with drop_prob, mean length drop_burst."""
+        mask = np.zeros(n_frames, dtype=bool)
+        carry = min(self._drop_left, n_frames)
+        mask[:carry] = True
+        self._drop_left -= carry
+        if self.drop_prob <= 0:
+            return mask
+        starts = np.flatnonzero(self._rng.random(n_frames) < self.drop_prob)
+        starts = starts[starts >= carry]
+        lengths = self._rng.geometric(1.0 / self.drop_burst, len(starts))
+        edges = np.zeros(n_frames + 1, dtype=np.int64)
+        np.add.at(edges, starts, 1)
+        np.add.at(edges, np.minimum(starts + lengths, n_frames), -1)
+        mask |= np.cumsum(edges[:-1]) > 0
+        if len(starts):
+            self._drop_left = max(self._drop_left, int((starts + lengths).max()) - n_frames)
+        return mask
+
+    def frames(self, n_frames, frame_samples):
+        """Next n_frames frames as a list with None for dropped ones."""
+        first = self._n + np.arange(n_frames, dtype=np.int64) * frame_samples
+        counts = self.counts(n_frames * frame_samples)
+        payload = counts.astype("<i4").view(np.uint8).reshape(n_frames, frame_samples, 4)[:, :, :3]
+        payload = payload.reshape(n_frames, -1)
+        if self.seq_bytes:
+            seqs = (self._seq + np.arange(n_frames, dtype=np.uint64)) % (1 << (8 * self.seq_bytes))
+            self._seq += n_frames
+            header = seqs.astype("<u8").view(np.uint8).reshape(n_frames, 8)[:, :self.seq_bytes]
+            payload = np.concatenate([header, payload], axis=1)
+        if self.tick_bytes:
+            ticks = (np.floor(first * self._ticks_per_sample).astype(np.int64)
+                     % (1 << (8 * self.tick_bytes))).astype("<u8")
+            header = ticks.view(np.uint8).reshape(n_frames, 8)[:, :self.tick_bytes]
+            payload = np.concatenate([payload[:, :self.seq_bytes], header, payload[:, self.seq_bytes:]], axis=1)
+        packed = np.ascontiguousarray(payload).tobytes()
+        size = payload.shape[1]
+        lost = self.dropped(n_frames).tolist()
+        return [None if lost[i] else packed[i * size:(i + 1) * size] for i in range(n_frames)]
+
+
+def udp_sender(host, port):
+    """send(sensor_id, frame) over the local transport."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sendto, pack, addr = sock.sendto, ingest.pack_local, (host, port)
+    return lambda sensor_id, frame: sendto(pack(sensor_id, frame), addr)
+
+
+def run(sensors, send, frame_samples, duration_s, rate_hz, backlog=None):
+    """
+    Generate duration_s of signal from every sensor and send it. rate_hz 0
+    sends as fast as possible (then backlog, if given, applies backpressure).
+    Returns a report dict.
+    """
+    chunk_frames = max(1, int(round(CHUNK_S * (rate_hz or 1000) / frame_samples)))
+    frame_s = frame_samples / rate_hz if rate_hz else 0.0
+    total_frames = int(round(duration_s * (rate_hz or 1000) / frame_samples))
+    sent = dropped = 0
+    max_lag = 0.0
+    max_backlog = 0
+    began = time.perf_counter()
+    f = 0
+    while f < total_frames:
+        n = min(chunk_frames, total_frames - f)
+        batches = [(s.sensor_id, s.frames(n, frame_samples)) for s in sensors]
+        for i in range(n):
+            if frame_s:
+                lag = time.perf_counter() - began - (f + i) * frame_s
+                if lag < 0:
+                    time.sleep(-lag)
+                max_lag = max(max_lag, lag)
+            elif backlog is not None:
+                depth = backlog()
+                max_backlog = max(max_backlog, depth)
+                while depth > MAX_BACKLOG:
+                    time.sleep(0.001)
+                    depth = backlog()
+            for sensor_id, frames in batches:
+                frame = frames[i]
+                if frame is None:
+                    dropped += 1
+                    continue
+                send(sensor_id, frame)
+                sent += 1
+        if backlog is not None:
+            max_backlog = max(max_backlog, backlog())
+        f += n
+    elapsed = time.perf_counter() - began
+    return {
+        "sensors": len(sensors),
+        "rate_hz": rate_hz,
+        "frame_samples": frame_samples,
+        "offered_samples_per_s": len(sensors) * rate_hz if rate_hz else None,
+        "frames_sent": sent,
+        "frames_dropped": dropped,
+        "samples_sent": sent * frame_samples,
+        "send_s": elapsed,
+        "sent_samples_per_s": sent * frame_samples / elapsed if elapsed else 0.0,
+        "max_lag_ms": max_lag * 1e3,
+        "max_backlog": max_backlog if backlog is not None else None,
+    }
+
+
+def server_counts(url):
+    """{sensor_id: samples} from a running final4.py's /sensors."""
+    with urllib.request.urlopen(url.rstrip("/") + "/sensors", timeout=5) as r:
+        return {s["sensor_id"]: s["samples"] for s in json.load(r)["sensors"]}
+
+
+def print_report(report):
+    offered = report["offered_samples_per_s"]
+    print(f"{report['sensors']} sensors × {report['rate_hz'] or 'max'} Hz, "
+          f"{report['frame_samples']} samples/frame"
+          + (f", offered {offered:.0f} samples/s" if offered else ""))
+    print(f"Sent {report['frames_sent']} frames ({report['samples_sent']} samples) "
+          f"in {report['send_s']:.2f} s = {report['sent_samples_per_s']:.0f} samples/s; "
+          f"{report['frames_dropped']} frames dropped by the dropout pattern")
+    if report["rate_hz"]:
+        print(f"Generator max lag {report['max_lag_ms']:.1f} ms")
+    if report.get("max_backlog") is not None:
+        print(f"Ingest queue max backlog {report['max_backlog']} frames")
+    if "detected_lost_frames" in report:
+        print(f"Host detected {report['detected_lost_frames']} lost frames from sequence gaps")
+    if "received_samples" in report:
+        print(f"Server stored {report['received_samples']} of {report['samples_sent']} samples")
+    if "elapsed_s" in report:
+        print(f"Drained after {report['elapsed_s']:.2f} s = {report['samples_per_s']:.0f} samples/s end to end")
+    if report.get("stages"):
+        print(f"{'stage':<10}{'mean ms':>10}{'p50 ms':>10}{'p95 ms':>10}{'p99 ms':>10}{'max ms':>10}")
+        for stage, s in report["stages"].items():
+            print(f"{stage:<10}{s['mean_ms']:>10.3f}{s['p50_ms']:>10.3f}{s['p95_ms']:>10.3f}"
+                  f"{s['p99_ms']:>10.3f}{s['max_ms']:>10.3f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate N torque sensors for load tests")
+    parser.add_argument("--sensors", type=int, default=4, help="number of simulated sensors")
+    parser.add_argument("--rate", type=float, default=100.0,
+                        help="samples/s per sensor; 0 = as fast as possible")
+    parser.add_argument("--frame-samples", type=int, default=1, help="samples per notification frame")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds of signal per sensor")
+    parser.add_argument("--noise", choices=NOISE_PROFILES, default="white")
+    parser.add_argument("--noise-level", type=float, default=0.05, help="noise RMS in N·cm")
+    parser.add_argument("--peak", type=float, default=20.0, help="cycle peak torque in N·cm")
+    parser.add_argument("--cycle", type=float, default=2.0, help="tightening cycle period in seconds")
+    parser.add_argument("--drop", type=float, default=0.0, help="probability a frame starts a dropout")
+    parser.add_argument("--drop-burst", type=float, default=1.0, help="mean frames lost per dropout")
+    parser.add_argument("--seq-bytes", type=int, default=None,
+                        help="frame sequence counter bytes (default: sequenceBytes from config.json)")
+    parser.add_argument("--tick-bytes", type=int, default=None,
+                        help="device tick counter bytes after the sequence number "
+                             "(default: tickBytes from config.json)")
+    parser.add_argument("--tick-hz", type=float, default=None,
+                        help="device tick rate (default: tickHz from config.json, else 32768)")
+    parser.add_argument("--drift-ppm", type=float, default=0.0,
+                        help="how far each simulated device clock runs off nominal")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("--prefix", default="sim", help="sensor ids are <prefix>-00, <prefix>-01, …")
+    parser.add_argument("--host", default=ingest.LOCAL_HOST)
+    parser.add_argument("--port", type=int, default=None,
+                        help="local ingest port of final4.py (default: localIngestPort from config.json)")
+    parser.add_argument("--server", default=None,
+                        help="final4.py base URL; compare its per-sensor sample counts afterwards")
+    parser.add_argument("--in-process", action="store_true",
+                        help="feed an IngestManager in this process instead of a running server")
+    parser.add_argument("--db", default="loadgen.db", help="database for --in-process")
+    parser.add_argument("--json", action="store_true", help="print the report as JSON")
+    args = parser.parse_args()
+
+    config = load_config()
+    offset = config.get("offset", 880804)
+    scale = config.get("scale", 1.33e-7)
+    sample_rate = args.rate or 1000.0  # signal time base when sending as fast as possible
+    seq_bytes = config.get("sequenceBytes", 0) if args.seq_bytes is None else args.seq_bytes
+    tick_bytes = config.get("tickBytes", 0) if args.tick_bytes is None else args.tick_bytes
+    tick_hz = config.get("tickHz", 32768) if args.tick_hz is None else args.tick_hz
+    seed = np.random.SeedSequence(args.seed).spawn(args.sensors)
+    sensors = [
+        SimSensor(f"{args.prefix}-{i:02d}", sample_rate, offset, scale, args.peak, args.cycle,
+                  args.noise, args.noise_level, args.drop, args.drop_burst, seed[i], seq_bytes,
+                  tick_bytes, tick_hz, args.drift_ppm * (1 + 0.5 * i / max(args.sensors - 1, 1)))
+        for i in range(args.sensors)
+    ]
+
+    if args.in_process:
+        manager = build_manager(config, args.db, seq_bytes, tick_bytes, tick_hz)
+        for s in sensors:
+            manager.attach(s.sensor_id)
+        manager.stage_times.reset()
+        manager.start_writer()
+        began_us = torque_store.now_us()
+        began = time.perf_counter()
+        report = run(sensors, manager.feed, args.frame_samples, args.duration, args.rate,
+                     manager.backlog)
+        manager.drain()
+        report["elapsed_s"] = time.perf_counter() - began
+        report["samples_per_s"] = manager.stage_times.samples / report["elapsed_s"]
+        report["received_samples"] = manager.stage_times.samples
+        report["stages"] = manager.stage_times.summary()
+        if seq_bytes:
+            report["detected_lost_frames"] = torque_store.gap_summary(began_us)["lost_frames"]
+    else:
+        port = args.port or config.get("localIngestPort", 0)
+        if not port:
+            parser.error("no port: pass --port or set localIngestPort in config.json")
+        before = server_counts(args.server) if args.server else {}
+        report = run(sensors, udp_sender(args.host, port), args.frame_samples, args.duration, args.rate)
+        if args.server:
+            time.sleep(1.0)  # let the writer flush
+            after = server_counts(args.server)
+            report["received_samples"] = sum(after.get(s.sensor_id, 0) - before.get(s.sensor_id, 0)
+                                             for s in sensors)
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+
+
+if __name__ == "__main__":
+    main()
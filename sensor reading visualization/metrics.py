@@ -0,0 +1,201 @@
+"""
+Ingest and storage health metrics in the Prometheus text format.
+
+Metrics are module-level objects updated from the hot paths (BLE handler,
+ingest writer, store); each update is a dict lookup and an add under a
+lock, and histograms take a whole batch of observations in one numpy call.
+Values that are cheaper to read than to track (queue depth, database
+size) are gauges filled in by callbacks at scrape time. render() produces
+the /metrics response.
+"""
+
+import threading
+
+import numpy as np
+
+CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8"
+
+
+class _Metric:
+    kind = None
+
+    def __init__(self, name, help_text, labels=()):
+        self.name = name
+        self.help = help_text
+        self.label_names = tuple(labels)
+        self._children = {}
+        self._lock = threading.Lock()
+        REGISTRY.append(self)
+
+    def labels(self, *values):
+        """The child for these label values (strings), created on first use."""
+        child = self._children.get(values)
+        if child is None:
+            with self._lock:
+                child = self._children.setdefault(values, self._new_child())
+        return child
+
+    def remove(self, *values):
+        self._children.pop(values, None)
+
+    def _label_text(self, values, extra=()):
+        pairs = list(zip(self.label_names, values)) + list(extra)
+        if not pairs:
+            return ""
+        escaped = (str(v).replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n") for _, v in pairs)
+        return "{" + ",".join(f'{k}="{v}"' for (k, _), v in zip(pairs, escaped)) + "}"
+
+    def render(self):
+        lines = [f"# HELP {self.name} {self.help}", f"# TYPE {self.name} {self.kind}"]
+        for values, child in sorted(self._children.items()):
+            lines.extend(child.render(self, values))
+        return lines
+
+
+class _Value:
+    def __init__(self):
+        self.value = 0.0
+        self._lock = threading.Lock()
+
+    def inc(self, amount=1.0):
+        with self._lock:
+            self.value += amount
+
+    def set(self, value):
+        self.value = float(value)
+
+    def render(self, metric, values):
+        return [f"{metric.name}{metric._label_text(values)} {_number(self.value)}"]
+
+
+class Counter(_Metric):
+    kind = "counter"
+
+    def _new_child(self):
+        return _Value()
+
+    def inc(self, amount=1.0):
+        """Increment the unlabelled counter."""
+        self.labels().inc(amount)
+
+
+class Gauge(_Metric):
+    kind = "gauge"
+
+    def __init__(self, name, help_text, labels=(), collect=None):
+        """collect, if given, returns {label values tuple: value} at every scrape."""
+        super().__init__(name, help_text, labels)
+        self._collect = collect
+
+    def _new_child(self):
+        return _Value()
+
+    def set(self, value):
+        self.labels().set(value)
+
+    def render(self):
+        if self._collect is not None:
+            fresh = {tuple(k): v for k, v in self._collect().items()}
+            for values in list(self._children):
+                if values not in fresh:
+                    self.remove(*values)
+            for values, value in fresh.items():
+                self.labels(*values).set(value)
+        return super().render()
+
+
+class _Buckets:
+    def __init__(self, bounds):
+        self.bounds = bounds
+        self.counts = np.zeros(len(bounds) + 1, dtype=np.int64)
+        self.sum = 0.0
+        self._lock = threading.Lock()
+
+    def observe(self, value):
+        i = int(np.searchsorted(self.bounds, value, side="left"))
+        with self._lock:
+            self.counts[i] += 1
+            self.sum += value
+
+    def observe_many(self, values):
+        values = np.asarray(values, dtype=np.float64).ravel()
+        if not len(values):
+            return
+        bins = np.bincount(np.searchsorted(self.bounds, values, side="left"), minlength=len(self.counts))
+        with self._lock:
+            self.counts += bins
+            self.sum += float(values.sum())
+
+    def render(self, metric, values):
+        with self._lock:
+            cumulative = np.cumsum(self.counts)
+            total = self.sum
+        lines = [
+            f"{metric.name}_bucket{metric._label_text(values, [('le', _number(le))])} {int(n)}"
+            for le, n in zip(self.bounds, cumulative[:-1])
+        ]
+        lines.append(f"{metric.name}_bucket{metric._label_text(values, [('le', '+Inf')])} {int(cumulative[-1])}")
+        lines.append(f"{metric.name}_sum{metric._label_text(values)} {_number(total)}")
+        lines.append(f"{metric.name}_count{metric._label_text(values)} {int(cumulative[-1])}")
+        return lines
+
+
+class Histogram(_Metric):
+    kind = "histogram"
+
+    def __init__(self, name, help_text, labels=(), buckets=()):
+        """buckets are the upper bounds; +Inf is implied."""
+        super().__init__(name, help_text, labels)
+        self.bounds = np.array(sorted(buckets), dtype=np.float64)
+
+    def _new_child(self):
+        return _Buckets(self.bounds)
+
+    def observe(self, value):
+        self.labels().observe(value)
+
+
+def _number(value):
+    if value == int(value) and abs(value) < 1e15:
+        return str(int(value))
+    return repr(float(value))
+
+
+REGISTRY = []
+
+SECONDS_BUCKETS = (0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5)
+RECONNECT_BUCKETS = (0.5, 1, 2, 5, 10, 30, 60, 120, 300, 600)
+
+# ── Ingest ──
+
+SAMPLES = Counter("torque_ingest_samples_total", "Samples decoded and stored", ["sensor"])
+FRAMES = Counter("torque_ingest_frames_total", "Notification frames received", ["sensor"])
+DECODE_ERRORS = Counter("torque_decode_errors_total",
+                        "Frames rejected or only partly decoded", ["sensor", "reason"])
+SEQUENCE_GAPS = Counter("torque_sequence_gaps_total", "Gaps in frame sequence numbers", ["sensor"])
+LOST_FRAMES = Counter("torque_lost_frames_total", "Frames missing from sequence gaps", ["sensor"])
+DROPPED_FRAMES = Counter("torque_dropped_frames_total",
+                         "Frames lost because their batch failed to decode or store", [])
+RECONNECTS = Counter("torque_reconnects_total", "Reconnect attempts after a lost link", ["sensor"])
+GATT_DISCOVERIES = Counter("torque_gatt_discoveries_total",
+                           "Service discoveries run because no cached characteristic handle worked", ["sensor"])
+RECONNECT_SECONDS = Histogram("torque_reconnect_duration_seconds",
+                              "Time from losing a link to streaming again", ["sensor"], RECONNECT_BUCKETS)
+BATCH_SAMPLES = Histogram("torque_batch_samples", "Samples per writer batch", [],
+                          (1, 10, 50, 100, 250, 500, 1000, 5000, 20000))
+STAGE_SECONDS = Histogram("torque_writer_stage_seconds",
+                          "Per-batch duration of each writer stage (queue wait, decode, analytics, store)",
+                          ["stage"], SECONDS_BUCKETS)
+
+# ── Storage ──
+
+COMMIT_SECONDS = Histogram("torque_store_commit_seconds",
+                           "Time to insert and commit one batch", [], SECONDS_BUCKETS)
+
+
+def render():
+    """All registered metrics as one Prometheus text exposition."""
+    lines = []
+    for metric in list(REGISTRY):
+        lines.extend(metric.render())
+    return "\n".join(lines) + "\n"
@@ -4,7 +4,6 @@ Bluetooth Low Energy Receiver for 24-bit ADC Torque Sensor Data
 Integrates with existing web UI dashboard
 """
 
-import asyncio
 from bleak import BleakClient, BleakScanner
 from datetime import datetime
 from flask import Flask, jsonify, send_from_directory
@@ -15,15 +14,21 @@ from reportlab.pdfgen import canvas
 import threading
 import time
 
+import ble_loop
+import stats
+import torque_store
+from ring import SampleRing
+
 class BluetoothReceiver:
     def __init__(self):
         self.client = None
         self.is_connected = False
         self.is_running = False
         self.current_torque = 0.0
-        self.data_history = []
         self.threshold = 50.0
         self.max_history = 1000
+        # Newest readings as (epoch µs, [adc_value, voltage_mv, torque]) rows, overwritten in place
+        self.data_history = SampleRing(self.max_history, width=3)
 
         # BLE configuration
         self.service_uuid = "12345678-1234-5678-1234-567812345678"
@@ -117,18 +122,8 @@ class BluetoothReceiver:
             voltage = self._adc_to_voltage(adc_value)
             torque = self._voltage_to_torque(voltage)
             
-            timestamp = datetime.now()
             self.current_torque = torque
-            
-            self.data_history.append({
-                'timestamp': timestamp,
-                'adc_value': adc_value,
-                'voltage': voltage * 1000,  # mV
-                'torque': torque
-            })
-            
-            if len(self.data_history) > self.max_history:
-                self.data_history.pop(0)
+            self.data_history.append(torque_store.now_us(), adc_value, voltage * 1000, torque)
             
             print(f"Received - ADC: {adc_value}, Voltage: {voltage*1000:.3f}mV, Torque: {torque:.2f} N·cm")
             
@@ -185,12 +180,13 @@ class BluetoothReceiver:
             fieldnames = ['timestamp', 'adc_value', 'voltage_mv', 'torque_ncm']
             writer = csv.DictWriter(csvfile, fieldnames=fieldnames)
             writer.writeheader()
-            for entry in self.data_history:
+            ts, rows = self.data_history.since()
+            for t, (adc_value, voltage_mv, torque) in zip(ts.tolist(), rows.tolist()):
                 writer.writerow({
-                    'timestamp': entry['timestamp'].isoformat(),
-                    'adc_value': entry['adc_value'],
-                    'voltage_mv': entry['voltage'],
-                    'torque_ncm': entry['torque']
+                    'timestamp': torque_store.format_us(t),
+                    'adc_value': int(adc_value),
+                    'voltage_mv': voltage_mv,
+                    'torque_ncm': torque
                 })
         return filename
 
@@ -207,15 +203,15 @@ class BluetoothReceiver:
         y -= 20
         c.drawString(50, y, f"Total Readings: {len(self.data_history)}")
         y -= 20
-        if self.data_history:
-            max_torque = max(entry['torque'] for entry in self.data_history)
-            min_torque = min(entry['torque'] for entry in self.data_history)
-            avg_torque = sum(entry['torque'] for entry in self.data_history) / len(self.data_history)
-            c.drawString(50, y, f"Max Torque: {max_torque:.2f} N·cm")
+        summary = stats.describe(self.data_history.since()[1][:, 2])
+        if summary:
+            c.drawString(50, y, f"Max Torque: {summary['max']:.2f} N·cm")
+            y -= 20
+            c.drawString(50, y, f"Min Torque: {summary['min']:.2f} N·cm")
             y -= 20
-            c.drawString(50, y, f"Min Torque: {min_torque:.2f} N·cm")
+            c.drawString(50, y, f"Avg Torque: {summary['mean']:.2f} N·cm")
             y -= 20
-            c.drawString(50, y, f"Avg Torque: {avg_torque:.2f} N·cm")
+            c.drawString(50, y, f"RMS Torque: {summary['rms']:.2f} N·cm")
         c.save()
         return filename
 
@@ -235,23 +231,17 @@ def styles():
 def script():
     return send_from_directory('.', 'transmitter.js')
 
+# The client and its notifications live on the shared BLE loop, which keeps
+# running between requests
 @app.route('/start', methods=['POST'])
 def start_bluetooth():
-    loop = asyncio.new_event_loop()
-    asyncio.set_event_loop(loop)
-    result = loop.run_until_complete(receiver.connect_to_transmitter())
-    if result:
-        loop.run_until_complete(receiver.start_receiving())
-    loop.close()
+    if ble_loop.run(receiver.connect_to_transmitter()):
+        ble_loop.run(receiver.start_receiving())
     return jsonify(receiver.get_status())
 
 @app.route('/stop', methods=['POST'])
 def stop_bluetooth():
-    loop = asyncio.new_event_loop()
-    asyncio.set_event_loop(loop)
-    result = loop.run_until_complete(receiver.stop_receiving())
-    loop.close()
-    return jsonify(result)
+    return jsonify(ble_loop.run(receiver.stop_receiving()))
 
 @app.route('/status')
 def status():
@@ -292,7 +282,4 @@ if __name__ == '__main__':
             time.sleep(1)
     except KeyboardInterrupt:
         print("Shutting down...")
-        loop = asyncio.new_event_loop()
-        asyncio.set_event_loop(loop)
-        loop.run_until_complete(receiver.stop_receiving())
-        loop.close()
\ No newline at end of file
+        ble_loop.run(receiver.stop_receiving(), timeout=10)
\ No newline at end of file
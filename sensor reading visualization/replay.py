@@ -0,0 +1,226 @@
+"""
+Replay recorded torque data through the live ingest path.
+
+Samples from a torque_data.db or a CSV export are packed back into 24-bit
+notification frames and fed to an IngestManager, so they go through the same
+decode, analytics (spectrogram, alerts, cycles) and storage code as BLE data.
+Results go to a separate database (replay.db by default).
+
+    python replay.py torque_data.db                 # real time
+    python replay.py torque_data.csv --speed 20     # 20x
+    python replay.py torque_data.db --speed 0       # as fast as possible
+"""
+
+import argparse
+import csv
+import json
+import sqlite3
+import time
+
+import numpy as np
+
+import alerts
+import cycles
+import torque_store
+from ingest import IngestManager
+
+MAX_BACKLOG = 50_000  # queued frames before an as-fast-as-possible replay waits for the writer
+
+
+def load_config(path="config.json"):
+    try:
+        with open(path, "r") as f:
+            return json.load(f)
+    except (FileNotFoundError, json.JSONDecodeError):
+        print("Warning: config.json not found or invalid, using default values")
+        return {}
+
+
+def build_manager(config, db_file, seq_bytes=0, tick_bytes=0, tick_hz=32768):
+    """
+    IngestManager with alerts and cycles, as final4.py builds it, writing to
+    db_file; fed frames carry a seq_bytes sequence counter and a tick_bytes
+    device tick counter when non-zero.
+    """
+    torque_store.DB_FILE = db_file
+    torque_store.init_db(offset=config.get("offset", 880804), scale=config.get("scale", 1.33e-7))
+    engine = alerts.AlertEngine()
+    engine.reload()
+    tracker = cycles.CycleTracker(config.get("cycleStartLevel", cycles.START_LEVEL),
+                                  config.get("cycleEndLevel", cycles.END_LEVEL),
+                                  config.get("cycleMinMs", cycles.MIN_CYCLE_MS))
+    return IngestManager(config.get("serviceUUID", ""), config.get("characteristicUUID", ""),
+                         config.get("sensorName", ""), config.get("manufacturerName", ""),
+                         sample_stride=3, alerts=engine, cycles=tracker,
+                         seq_bytes=seq_bytes, tick_bytes=tick_bytes, tick_hz=tick_hz)
+
+
+def load_recording(path, offset, scale):
+    """
+    Read a recording into (ts_us, raw, sensor_ids) arrays in recorded order.
+    Files holding calibrated torque only are turned back into counts with
+    offset / scale, as the store's own migration does.
+    """
+    if path.endswith(".db"):
+        rows, columns = _db_rows(path)
+    else:
+        with open(path, newline="") as f:
+            reader = csv.reader(f)
+            columns = next(reader)
+            rows = list(reader)
+    if not rows:
+        return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.int64), np.empty(0, dtype=object)
+    col = {name: i for i, name in enumerate(columns)}
+    values = list(zip(*rows))
+
+    if "timestamp_us" in col:
+        ts = np.array(values[col["timestamp_us"]], dtype=np.int64)
+    else:
+        ts = np.array([torque_store.to_us(str(v).replace(" ", "T")) for v in values[col["timestamp"]]],
+                      dtype=np.int64)
+    if "raw" in col:
+        raw = np.array(values[col["raw"]], dtype=np.int64)
+    else:
+        torque = np.array(values[col["torque_value"]], dtype=np.float64)
+        raw = np.round(torque / scale + offset).astype(np.int64)
+    if "sensor_id" in col:
+        sensors = np.array(values[col["sensor_id"]], dtype=object)
+    else:
+        sensors = np.full(len(ts), torque_store.DEFAULT_SENSOR, dtype=object)
+    return ts, raw, sensors
+
+
+def _db_rows(path):
+    conn = sqlite3.connect(path)
+    columns = [row[1] for row in conn.execute("PRAGMA table_info(torque_data)")]
+    if "raw" in columns:
+        select = ["ts_us AS timestamp_us", "raw", "sensor_id"]
+    else:
+        select = ["ts_us AS timestamp_us" if "ts_us" in columns else "timestamp", "torque_value"]
+        if "sensor_id" in columns:
+            select.append("sensor_id")
+    cur = conn.execute(f"SELECT {', '.join(select)} FROM torque_data ORDER BY id")
+    names = [d[0] for d in cur.description]
+    rows = [r for r in cur.fetchall() if None not in r]
+    conn.close()
+    return rows, names
+
+
+def build_frames(raw, sensors, frame_samples):
+    """
+    Pack counts into notification frames of up to frame_samples samples, never
+    mixing sensors. Returns (packed bytes, frame start indices).
+    """
+    n = len(raw)
+    change = np.ones(n, dtype=bool)
+    change[1:] = sensors[1:] != sensors[:-1]
+    run_start = np.flatnonzero(change)
+    pos = np.arange(n) - run_start[np.cumsum(change) - 1]
+    starts = np.flatnonzero(change | (pos % frame_samples == 0))
+    packed = raw.astype("<i4").view(np.uint8).reshape(n, 4)[:, :3].tobytes()
+    return packed, starts
+
+
+def schedule(ts, starts, speed, max_gap_s):
+    """Seconds after replay start at which each frame is due; gaps are capped."""
+    if speed <= 0:
+        return np.zeros(len(starts))
+    gaps = np.clip(np.diff(ts[starts]), 0, int(max_gap_s * 1e6))
+    return np.concatenate([[0], np.cumsum(gaps)]) / 1e6 / speed
+
+
+def replay(manager, ts, raw, sensors, speed=1.0, frame_samples=1, keep_timestamps=False,
+           max_gap_s=5.0):
+    """Feed the recording to manager at `speed` (0 = as fast as possible); returns a report dict."""
+    packed, starts = build_frames(raw, sensors, frame_samples)
+    due = schedule(ts, starts, speed, max_gap_s)
+    ends = np.append(starts[1:], len(raw)) * 3
+    offsets = starts * 3
+    frame_ts = ts[starts].tolist()
+    frame_sensor = sensors[starts].tolist()
+    for sensor_id in set(frame_sensor):
+        manager.attach(sensor_id)
+
+    manager.stage_times.reset()
+    manager.start_writer()
+    feed = manager.feed
+    began = time.perf_counter()
+    i = 0
+    while i < len(starts):
+        now = time.perf_counter() - began
+        j = int(np.searchsorted(due, now, side="right"))
+        if j == i:
+            time.sleep(min(due[i] - now, 0.05))
+            continue
+        if manager.backlog() > MAX_BACKLOG:
+            time.sleep(0.001)
+            continue
+        j = min(j, i + MAX_BACKLOG)
+        for f in range(i, j):
+            feed(frame_sensor[f], packed[offsets[f]:ends[f]],
+                 frame_ts[f] if keep_timestamps else None)
+        i = j
+    fed = time.perf_counter() - began
+    manager.drain()
+    elapsed = time.perf_counter() - began
+
+    span_s = (ts[-1] - ts[0]) / 1e6 if len(ts) else 0.0
+    return {
+        "samples": int(len(raw)),
+        "frames": int(len(starts)),
+        "sensors": sorted(set(frame_sensor)),
+        "recorded_span_s": span_s,
+        "feed_s": fed,
+        "elapsed_s": elapsed,
+        "samples_per_s": len(raw) / elapsed if elapsed else 0.0,
+        "stored_samples": manager.stage_times.samples,
+        "stages": manager.stage_times.summary(),
+    }
+
+
+def print_report(report):
+    print(f"Replayed {report['samples']} samples in {report['frames']} frames "
+          f"from {len(report['sensors'])} sensor(s)")
+    print(f"Elapsed {report['elapsed_s']:.2f} s (feeding {report['feed_s']:.2f} s), "
+          f"{report['samples_per_s']:.0f} samples/s, "
+          f"{report['stored_samples']} stored")
+    print(f"{'stage':<10}{'mean ms':>10}{'p50 ms':>10}{'p95 ms':>10}{'p99 ms':>10}{'max ms':>10}")
+    for stage, s in report["stages"].items():
+        print(f"{stage:<10}{s['mean_ms']:>10.3f}{s['p50_ms']:>10.3f}{s['p95_ms']:>10.3f}"
+              f"{s['p99_ms']:>10.3f}{s['max_ms']:>10.3f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay recorded torque data through ingest")
+    parser.add_argument("source", help="torque_data.db or a CSV export")
+    parser.add_argument("--speed", type=float, default=1.0,
+                        help="replay speed multiplier; 0 = as fast as possible")
+    parser.add_argument("--db", default="replay.db", help="database the replay writes to")
+    parser.add_argument("--frame-samples", type=int, default=1,
+                        help="samples packed into each notification frame")
+    parser.add_argument("--keep-timestamps", action="store_true",
+                        help="store recorded timestamps instead of replay arrival times")
+    parser.add_argument("--max-gap", type=float, default=5.0,
+                        help="longest pause (recorded seconds) honoured between samples")
+    parser.add_argument("--json", action="store_true", help="print the report as JSON")
+    args = parser.parse_args()
+
+    config = load_config()
+    offset = config.get("offset", 880804)
+    scale = config.get("scale", 1.33e-7)
+    ts, raw, sensors = load_recording(args.source, offset, scale)
+    if not len(ts):
+        print("No samples in recording")
+        return
+
+    manager = build_manager(config, args.db)
+    report = replay(manager, ts, raw, sensors, args.speed, args.frame_samples,
+                    args.keep_timestamps, args.max_gap)
+    if args.json:
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,211 @@
+"""
+Uniform-grid resampling of the stored, irregularly spaced torque series.
+
+resample() puts one time range onto a grid of rate_hz points per second,
+per sensor, in one of three modes:
+
+  linear  interpolate between the samples either side of each grid point
+  hold    the last sample at or before each grid point
+  mean    mean of the samples in [t, t + step) for each grid point t
+
+Nothing is made up across a hole. A grid point comes back as NaN, with
+its valid flag False, when:
+- the samples either side of it are more than max_gap_us apart (linear, hold);
+- its bin is empty (mean);
+- it falls inside a recorded data gap (see gaps.py).
+
+Rows are read from the store in large chunks, and each chunk is placed on
+the grid with a few searchsorted / bincount passes. Memory is bounded by
+the grid, not by the number of samples. A mean over whole minutes is taken
+straight from the minute rollups, so multi-day ranges never read raw rows.
+"""
+
+import numpy as np
+
+import torque_store
+
+MODES = ("linear", "hold", "mean")
+GAP_FACTOR = 4.0            # a hole longer than this many median sample intervals is a gap
+MAX_GRID_POINTS = 5_000_000  # grid points per sensor
+READ_ROWS = 200_000         # rows per store query
+EDGE_US = 1_000_000         # read this far past the range for the edge points' neighbours
+
+
+class Grid:
+    """Grid points origin_us + k * step_us, k < n."""
+
+    def __init__(self, start_us, end_us, rate_hz, bins=False):
+        if not rate_hz or rate_hz <= 0:
+            raise ValueError("rate must be positive")
+        self.step_us = max(1, int(round(1e6 / rate_hz)))
+        # Aligned to the step, so grids of overlapping requests line up; as
+        # bins [t, t + step) the first one starts at or before start_us
+        if bins:
+            self.origin_us = start_us - start_us % self.step_us
+        else:
+            self.origin_us = -(-start_us // self.step_us) * self.step_us
+        self.n = max(0, (end_us - self.origin_us) // self.step_us + 1)
+
+    @property
+    def rate_hz(self):
+        return 1e6 / self.step_us
+
+    def times(self, lo=0, hi=None):
+        hi = self.n if hi is None else hi
+        return self.origin_us + self.step_us * np.arange(lo, hi, dtype=np.int64)
+
+    def index_after(self, ts_us):
+        """Index of the first grid point strictly after ts_us, clipped to [0, n]."""
+        return np.clip((np.asarray(ts_us) - self.origin_us) // self.step_us + 1, 0, self.n)
+
+    def index_from(self, ts_us):
+        """Index of the first grid point at or after ts_us, clipped to [0, n]."""
+        return np.clip(-(-(np.asarray(ts_us) - self.origin_us) // self.step_us), 0, self.n)
+
+
+class _Track:
+    """Grid values of one sensor, filled chunk by chunk in time order."""
+
+    def __init__(self, grid, mode, max_gap_us):
+        self.grid = grid
+        self.mode = mode
+        self.max_gap_us = max_gap_us
+        self.values = np.full(grid.n, np.nan)
+        self.valid = np.zeros(grid.n, dtype=bool)
+        if mode == "mean":
+            self.sums = np.zeros(grid.n)
+            self.counts = np.zeros(grid.n, dtype=np.int64)
+        self.last = None     # (ts, value) of the newest sample seen (linear, hold)
+        self.next_k = None   # first grid point not evaluated yet
+
+    def add(self, ts, values):
+        if len(ts) > 1 and np.any(ts[1:] < ts[:-1]):
+            order = np.argsort(ts, kind="stable")
+            ts, values = ts[order], values[order]
+        if self.last is not None and self.mode != "mean":
+            # Rows stored out of order behind already evaluated points are dropped
+            keep = ts >= self.last[0]
+            ts, values = ts[keep], values[keep]
+        if not len(ts):
+            return
+        if self.max_gap_us is None and len(ts) > 1:
+            steps = np.diff(ts)
+            steps = steps[steps > 0]
+            if len(steps):
+                self.max_gap_us = GAP_FACTOR * float(np.median(steps))
+
+        if self.mode == "mean":
+            k = (ts - self.grid.origin_us) // self.grid.step_us
+            inside = (k >= 0) & (k < self.grid.n)
+            k, values = k[inside], values[inside]
+            if len(k):
+                lo = int(k[0])
+                self.sums[lo:int(k[-1]) + 1] += np.bincount(k - lo, weights=values)
+                self.counts[lo:int(k[-1]) + 1] += np.bincount(k - lo)
+            return
+
+        if self.last is None:
+            xs, vs = ts, values
+            lo = int(self.grid.index_from(xs[0]))
+        else:
+            xs = np.concatenate([[self.last[0]], ts])
+            vs = np.concatenate([[self.last[1]], values])
+            lo = self.next_k
+        self.last = (int(xs[-1]), float(vs[-1]))
+        # Every grid point up to the newest sample has both neighbours now
+        hi = int(self.grid.index_after(xs[-1]))
+        self.next_k = max(lo, hi)
+        if hi <= lo:
+            return
+        t = self.grid.times(lo, hi)
+        i = np.searchsorted(xs, t, side="right") - 1
+        j = np.minimum(i + 1, len(xs) - 1)
+        exact = xs[i] == t
+        span = xs[j] - xs[i]
+        if self.mode == "linear":
+            frac = np.where(exact, 0.0, (t - xs[i]) / np.where(span > 0, span, 1))
+            out = vs[i] + (vs[j] - vs[i]) * frac
+        else:
+            out = vs[i]
+        ok = exact | (span <= self.max_gap_us) if self.max_gap_us is not None else np.ones(len(t), dtype=bool)
+        self.values[lo:hi] = np.where(ok, out, np.nan)
+        self.valid[lo:hi] = ok
+
+    def finish(self, gaps):
+        if self.mode == "mean":
+            self.valid = self.counts > 0
+            self.values[self.valid] = self.sums[self.valid] / self.counts[self.valid]
+        elif gaps:
+            # Grid points strictly inside a recorded gap, marked with a difference array
+            starts = self.grid.index_after([g[0] for g in gaps])
+            ends = self.grid.index_from([g[1] for g in gaps])
+            delta = np.zeros(self.grid.n + 1, dtype=np.int64)
+            np.add.at(delta, starts, 1)
+            np.add.at(delta, ends, -1)
+            inside = np.cumsum(delta[:-1]) > 0
+            self.valid &= ~inside
+            self.values[inside] = np.nan
+        return self.values, self.valid
+
+
+def resample(start=None, end=None, sensor_id=None, rate_hz=1.0, mode="linear",
+             max_gap_us=None, calibration=None):
+    """
+    Resample [start, end] (epoch µs, inclusive; default all stored data) to
+    rate_hz. Returns None when no samples match, otherwise
+    dict(grid=Grid, mode, sensors={sensor_id: (values, valid)}) with one
+    float64 value per grid point (NaN where not valid). max_gap_us defaults
+    to GAP_FACTOR times each sensor's median sample interval.
+    """
+    if mode not in MODES:
+        raise ValueError(f"mode must be one of {', '.join(MODES)}")
+    bounds = torque_store.time_bounds(start, end, sensor_id)
+    if bounds is None:
+        return None
+    grid = Grid(bounds[0], bounds[1], rate_hz, bins=mode == "mean")
+    if grid.n > MAX_GRID_POINTS:
+        raise ValueError(f"{grid.n} grid points per sensor; lower the rate or "
+                         f"narrow the range to at most {MAX_GRID_POINTS}")
+    if calibration is None:
+        calibration = torque_store.load_calibration()
+
+    if mode == "mean" and grid.step_us % torque_store.MINUTE_US == 0:
+        sensors = _mean_from_rollups(grid, start, end, sensor_id, calibration)
+        return {"grid": grid, "mode": mode, "sensors": sensors}
+
+    edge = 0 if mode == "mean" else int(max_gap_us or EDGE_US)
+    tracks = {}
+    for _, ts, _, torque, sensors in torque_store.calibrated_chunks(
+            bounds[0] - edge, bounds[1] + edge, sensor_id, calibration, chunk_rows=READ_ROWS):
+        names, codes = np.unique(np.asarray(sensors, dtype=str), return_inverse=True)
+        for code, sid in enumerate(names.tolist()):
+            track = tracks.get(sid)
+            if track is None:
+                track = tracks[sid] = _Track(grid, mode, max_gap_us)
+            mask = codes == code if len(names) > 1 else slice(None)
+            track.add(ts[mask], torque[mask])
+
+    gaps = {}
+    if mode != "mean":
+        for g in torque_store.list_gaps(bounds[0], bounds[1], sensor_id):
+            gaps.setdefault(g["sensor_id"], []).append((g["start_us"], g["end_us"]))
+    return {"grid": grid, "mode": mode,
+            "sensors": {sid: track.finish(gaps.get(sid)) for sid, track in sorted(tracks.items())}}
+
+
+def _mean_from_rollups(grid, start, end, sensor_id, calibration):
+    """Bin means over whole minutes from the minute rollups (bounds truncated to the minute)."""
+    r = torque_store._calibrated_rollups(start, end, sensor_id, calibration)
+    result = {}
+    if r is None:
+        return result
+    k = (r["bucket"] - grid.origin_us) // grid.step_us
+    for sid in sorted(set(r["sensor_id"])):
+        mask = (r["sensor_id"] == sid) & (k >= 0) & (k < grid.n)
+        n = np.bincount(k[mask], weights=r["n"][mask], minlength=grid.n)
+        total = np.bincount(k[mask], weights=r["total"][mask], minlength=grid.n)
+        valid = n > 0
+        values = np.full(grid.n, np.nan)
+        values[valid] = total[valid] / n[valid]
+        result[sid] = (values, valid)
+    return result
@@ -0,0 +1,100 @@
+"""
+Fixed-capacity in-memory sample ring for "last N seconds" queries.
+
+Each sensor keeps its newest samples in two preallocated numpy arrays
+(int64 epoch µs timestamps, float64 values) that are written in place: no
+allocation per sample and no shifting, unlike a list trimmed with pop(0).
+Live charts backfill from it and recent-window queries never touch SQLite.
+Readers get ordered copies, so the writer can keep going while they
+work on them.
+"""
+
+import threading
+
+import numpy as np
+
+
+class SampleRing:
+    """
+    The newest `capacity` (ts_us, values) rows of one sensor. values has
+    `width` columns (1: a plain value per sample). Timestamps are expected
+    in non-decreasing order, as the ingest writer produces them.
+    """
+
+    def __init__(self, capacity, width=1):
+        self.capacity = int(capacity)
+        self.width = width
+        self.ts = np.zeros(self.capacity, dtype=np.int64)
+        self.values = np.zeros((self.capacity, width) if width > 1 else self.capacity)
+        self.head = 0   # next slot to write
+        self.count = 0  # filled slots
+        self._lock = threading.Lock()
+
+    @classmethod
+    def for_window(cls, seconds, rate_hz, width=1):
+        """A ring holding `seconds` of samples at up to rate_hz."""
+        return cls(max(1, int(seconds * rate_hz)), width)
+
+    def __len__(self):
+        return self.count
+
+    def append(self, ts_us, *values):
+        """Add one sample in place."""
+        with self._lock:
+            self.ts[self.head] = ts_us
+            self.values[self.head] = values if self.width > 1 else values[0]
+            self.head = (self.head + 1) % self.capacity
+            self.count = min(self.count + 1, self.capacity)
+
+    def extend(self, ts_us, values):
+        """Add a batch: at most two slice copies, whatever its size."""
+        ts_us = np.asarray(ts_us)
+        n = len(ts_us)
+        if not n:
+            return
+        values = np.asarray(values)
+        if n > self.capacity:
+            ts_us, values, n = ts_us[-self.capacity:], values[-self.capacity:], self.capacity
+        with self._lock:
+            first = min(n, self.capacity - self.head)
+            self.ts[self.head:self.head + first] = ts_us[:first]
+            self.values[self.head:self.head + first] = values[:first]
+            self.ts[:n - first] = ts_us[first:]
+            self.values[:n - first] = values[first:]
+            self.head = (self.head + n) % self.capacity
+            self.count = min(self.count + n, self.capacity)
+
+    def latest(self):
+        """(ts_us, value) of the newest sample, or None."""
+        with self._lock:
+            if not self.count:
+                return None
+            i = (self.head - 1) % self.capacity
+            return int(self.ts[i]), self.values[i].copy() if self.width > 1 else float(self.values[i])
+
+    def since(self, ts_us=None):
+        """Ordered copies (ts, values) of the samples at or after ts_us (all when None)."""
+        with self._lock:
+            start = (self.head - self.count) % self.capacity
+            # The filled part is at most two contiguous runs: [start:] then [:head]
+            if start + self.count <= self.capacity:
+                runs = [slice(start, start + self.count)]
+            else:
+                runs = [slice(start, self.capacity), slice(0, self.head)]
+            if ts_us is not None:
+                runs = [slice(r.start + int(np.searchsorted(self.ts[r], ts_us, side="left")), r.stop)
+                        for r in runs]
+            ts = np.concatenate([self.ts[r] for r in runs])
+            values = np.concatenate([self.values[r] for r in runs])
+        return ts, values
+
+    def window(self, seconds):
+        """Samples of the last `seconds`, counted back from the newest one."""
+        newest = self.latest()
+        if newest is None:
+            return self.since()
+        return self.since(newest[0] - int(seconds * 1e6))
+
+    def clear(self):
+        with self._lock:
+            self.head = self.count = 0
@@ -0,0 +1,155 @@
+"""
+Streaming spectral analysis of the torque signal.
+Each sensor gets a Spectrogram that turns ingested samples into short-time
+power spectra (Hann window, 50 % overlap) kept in a fixed-size ring, from
+which the API serves a downsampled spectrogram or a Welch average.
+"""
+
+import threading
+
+import numpy as np
+
+NFFT = 256          # samples per STFT frame
+HOP = NFFT // 2     # 50 % overlap
+MAX_FRAMES = 1200   # spectra kept per sensor
+BATCH_FRAMES = 64   # frames transformed per rfft call
+
+
+class Spectrogram:
+    """
+    Rolling STFT of one sensor. add() is called from the ingest writer thread,
+    the readers from Flask threads. Input and output buffers are allocated up
+    front and frames are transformed in batches of up to BATCH_FRAMES with one
+    rfft call; numpy caches the FFT plan per length, so every batch reuses it.
+    """
+
+    def __init__(self, nfft=NFFT, hop=HOP, max_frames=MAX_FRAMES):
+        self.nfft = nfft
+        self.hop = hop
+        self.max_frames = max_frames
+        self.bins = nfft // 2 + 1
+
+        self._window = np.hanning(nfft)
+        # PSD scaling for a one-sided spectrum in (N·cm)²/Hz, times fs
+        self._scale = np.full(self.bins, 2.0 / np.dot(self._window, self._window))
+        self._scale[0] /= 2
+        if nfft % 2 == 0:
+            self._scale[-1] /= 2
+
+        # Input carry: samples not yet covered by a full frame
+        self._pending = np.empty(nfft + hop * (BATCH_FRAMES - 1), dtype=np.float64)
+        self._pending_ts = np.empty(len(self._pending), dtype=np.int64)
+        self._n_pending = 0
+
+        # Output ring
+        self._psd = np.zeros((max_frames, self.bins), dtype=np.float32)
+        self._frame_ts = np.zeros(max_frames, dtype=np.int64)
+        self._frame_fs = np.zeros(max_frames, dtype=np.float64)
+        self._head = 0   # next slot to write
+        self._count = 0  # frames held
+        self._lock = threading.Lock()
+
+    def add(self, ts_us, values):
+        """Append samples (epoch µs timestamps, torque) and compute every complete frame."""
+        ts_us = np.asarray(ts_us, dtype=np.int64)
+        values = np.asarray(values, dtype=np.float64)
+        while len(values):
+            room = len(self._pending) - self._n_pending
+            take = min(room, len(values))
+            end = self._n_pending + take
+            self._pending[self._n_pending:end] = values[:take]
+            self._pending_ts[self._n_pending:end] = ts_us[:take]
+            self._n_pending = end
+            values, ts_us = values[take:], ts_us[take:]
+            self._drain()
+
+    def _drain(self):
+        n_frames = (self._n_pending - self.nfft) // self.hop + 1
+        if n_frames <= 0:
+            return
+        frames = np.lib.stride_tricks.sliding_window_view(
+            self._pending[:self._n_pending], self.nfft)[::self.hop][:n_frames]
+        stamps = np.lib.stride_tricks.sliding_window_view(
+            self._pending_ts[:self._n_pending], self.nfft)[::self.hop][:n_frames]
+
+        # Sample rate per frame from its own timestamps (BLE has no fixed clock)
+        span = (stamps[:, -1] - stamps[:, 0]) / 1e6
+        fs = np.where(span > 0, (self.nfft - 1) / np.where(span > 0, span, 1), 0.0)
+
+        # Remove each frame's mean so the DC bin does not swamp the spectrum
+        detrended = frames - frames.mean(axis=1, keepdims=True)
+        spectra = np.fft.rfft(detrended * self._window, axis=1)
+        power = (spectra.real ** 2 + spectra.imag ** 2) * self._scale
+        power /= np.where(fs > 0, fs, 1)[:, None]
+
+        slots = (self._head + np.arange(n_frames)) % self.max_frames
+        with self._lock:
+            self._psd[slots] = power
+            self._frame_ts[slots] = stamps[:, self.nfft // 2]
+            self._frame_fs[slots] = fs
+            self._head = (self._head + n_frames) % self.max_frames
+            self._count = min(self._count + n_frames, self.max_frames)
+
+        # Keep the overlap tail for the next frame
+        consumed = n_frames * self.hop
+        keep = self._n_pending - consumed
+        self._pending[:keep] = self._pending[consumed:self._n_pending]
+        self._pending_ts[:keep] = self._pending_ts[consumed:self._n_pending]
+        self._n_pending = keep
+
+    def _snapshot(self, since_us=None):
+        """Copy of the held frames, oldest first: (ts, fs, psd)."""
+        with self._lock:
+            order = (np.arange(self._count) + self._head - self._count) % self.max_frames
+            ts = self._frame_ts[order]
+            fs = self._frame_fs[order]
+            psd = self._psd[order]
+        if since_us is not None:
+            keep = ts >= since_us
+            ts, fs, psd = ts[keep], fs[keep], psd[keep]
+        return ts, fs, psd
+
+    def _freqs(self, fs):
+        """Frequency axis for the median frame rate; bin indices if the rate is unknown."""
+        rate = float(np.median(fs[fs > 0])) if np.any(fs > 0) else 0.0
+        if not rate:
+            return np.arange(self.bins, dtype=np.float64), rate
+        return np.fft.rfftfreq(self.nfft, 1 / rate), rate
+
+    def spectrogram(self, since_us=None, max_frames=200, max_bins=128):
+        """
+        Downsampled spectrogram: time frames averaged in groups and frequency
+        bins averaged in groups so at most max_frames × max_bins values remain.
+        Returns dict(t, freqs, sample_rate_hz, psd_db) or None if no frames.
+        """
+        ts, fs, psd = self._snapshot(since_us)
+        if not len(ts):
+            return None
+        freqs, rate = self._freqs(fs)
+        t_step = max(1, -(-len(ts) // max_frames))
+        f_step = max(1, -(-self.bins // max_bins))
+        t_starts = np.arange(0, len(ts), t_step)
+        f_starts = np.arange(0, self.bins, f_step)
+        pooled = np.add.reduceat(psd.astype(np.float64), t_starts, axis=0)
+        pooled = np.add.reduceat(pooled, f_starts, axis=1)
+        pooled /= np.diff(np.append(t_starts, len(ts)))[:, None]
+        pooled /= np.diff(np.append(f_starts, self.bins))[None, :]
+        return {
+            "t": ts[t_starts].tolist(),
+            "freqs": freqs[f_starts].tolist(),
+            "sample_rate_hz": rate,
+            "psd_db": np.round(10 * np.log10(np.maximum(pooled, 1e-20)), 2).tolist(),
+        }
+
+    def welch(self, since_us=None):
+        """Welch PSD estimate: mean of the held frames. dict(freqs, psd, frames) or None."""
+        ts, fs, psd = self._snapshot(since_us)
+        if not len(ts):
+            return None
+        freqs, rate = self._freqs(fs)
+        return {
+            "freqs": freqs.tolist(),
+            "sample_rate_hz": rate,
+            "frames": int(len(ts)),
+            "psd": psd.mean(axis=0, dtype=np.float64).tolist(),
+        }
@@ -6,14 +6,53 @@ document.addEventListener("DOMContentLoaded", () => {
   const threshInput = document.getElementById("threshold");
   const threshVal   = document.getElementById("thresh-val");
 
-  // Persist threshold
-  threshInput.value = localStorage.getItem("threshold")||50;
+  const alertsEl    = document.getElementById("alerts");
+
+  // The threshold is a server-side alert rule shared by every browser and
+  // evaluated on every sample during ingest, not just on each poll
+  const THRESHOLD_RULE = "dashboard-threshold";
   threshVal.innerText = threshInput.value;
+  fetch("/alerts/rules")
+    .then(r => r.json())
+    .then(j => {
+      const rule = j.rules.find(r => r.name === THRESHOLD_RULE);
+      if (rule) {
+        threshInput.value = rule.params.level;
+        threshVal.innerText = threshInput.value;
+        chart.setThreshold(rule.params.level);
+      }
+    })
+    .catch(err => console.error("Rules fetch error:", err));
   threshInput.oninput = () => {
     threshVal.innerText = threshInput.value;
-    localStorage.setItem("threshold", threshInput.value);
+    chart.setThreshold(Number(threshInput.value));
+  };
+  threshInput.onchange = () => {
+    fetch("/alerts/rules", {
+      method: "POST",
+      headers: { "Content-Type": "application/json" },
+      body: JSON.stringify({
+        name: THRESHOLD_RULE,
+        kind: "threshold",
+        params: { level: Number(threshInput.value), direction: "above" }
+      })
+    }).catch(err => console.error("Rule save error:", err));
   };
 
+  // Alert events pushed by the server as they are raised / cleared
+  if (alertsEl && window.EventSource) {
+    const source = new EventSource("/alerts/stream");
+    source.addEventListener("alert", (e) => {
+      const ev = JSON.parse(e.data);
+      const li = document.createElement("li");
+      li.className = ev.state;
+      li.innerText = `${new Date(ev.ts_us / 1000).toLocaleTimeString()}  ${ev.rule_name} ` +
+                     `${ev.state} on ${ev.sensor_id} (${ev.value.toFixed(2)} N·cm)`;
+      alertsEl.prepend(li);
+      while (alertsEl.children.length > 10) alertsEl.lastChild.remove();
+    });
+  }
+
   // Start BLE reader
   document.getElementById("btn-start").onclick = () => {
     fetch("/start")
@@ -39,6 +78,132 @@ document.addEventListener("DOMContentLoaded", () => {
     };
   }
 
+  // ── Live chart ──
+  // One fixed-size typed-array ring per sensor holds the newest MAX_POINTS
+  // samples. New samples from /recent are appended with Plotly.extendTraces
+  // (capped at MAX_POINTS), so a tick costs the new points only, never a
+  // full re-render. Traces switch to WebGL once they hold more than
+  // GL_POINTS points.
+  const MAX_POINTS = 5000;    // per sensor, on screen and in the ring
+  const GL_POINTS = 1000;     // above this, draw with scattergl
+  const BACKFILL_S = 60;      // history fetched from the server's ring on load
+  const CHART_POLL_MS = 250;
+  const LAG_US = 2e6;         // how far one sensor may trail another and still be caught up
+
+  const chart = {
+    rings: new Map(),         // sensor_id -> { t, v: Float64Array, head, count, trace }
+    gl: false,
+    ready: false,
+
+    ring(sensorId) {
+      let ring = this.rings.get(sensorId);
+      if (!ring) {
+        ring = { t: new Float64Array(MAX_POINTS), v: new Float64Array(MAX_POINTS),
+                 head: 0, count: 0, newest: -Infinity, trace: this.rings.size };
+        this.rings.set(sensorId, ring);
+        if (this.ready) Plotly.addTraces(graphEl, this.trace(sensorId, ring));
+      }
+      return ring;
+    },
+
+    // Ordered copy of a ring, for (re)building its trace
+    ordered(ring) {
+      const x = new Float64Array(ring.count), y = new Float64Array(ring.count);
+      const oldest = (ring.head - ring.count + MAX_POINTS) % MAX_POINTS;
+      for (let i = 0; i < ring.count; i++) {
+        const k = (oldest + i) % MAX_POINTS;
+        x[i] = ring.t[k];
+        y[i] = ring.v[k];
+      }
+      return { x: Array.from(x), y: Array.from(y) };
+    },
+
+    trace(sensorId, ring) {
+      const { x, y } = this.ordered(ring);
+      return { x, y, name: sensorId, mode: "lines", type: this.gl ? "scattergl" : "scatter" };
+    },
+
+    draw() {
+      const traces = [...this.rings].map(([sid, ring]) => this.trace(sid, ring));
+      Plotly.react(graphEl, traces, {
+        margin: { t: 30 }, title: "Real-Time Torque",
+        xaxis: { type: "date" },   // x values are epoch milliseconds
+        yaxis: { title: "N·cm" },
+        shapes: [this.thresholdLine(Number(threshInput.value))]
+      });
+      this.ready = true;
+    },
+
+    thresholdLine(level) {
+      return { type: "line", xref: "paper", x0: 0, x1: 1, y0: level, y1: level,
+               line: { color: "tomato", width: 1, dash: "dot" } };
+    },
+
+    setThreshold(level) {
+      if (this.ready) Plotly.relayout(graphEl, { shapes: [this.thresholdLine(level)] });
+    },
+
+    // Append server samples (t in epoch µs) for one sensor; returns the new points
+    append(sensorId, ts, vs) {
+      const ring = this.ring(sensorId);
+      const x = [], y = [];
+      for (let i = 0; i < ts.length; i++) {
+        if (ts[i] <= ring.newest) continue;  // already held (overlapping polls)
+        ring.newest = ts[i];
+        const ms = ts[i] / 1000;
+        ring.t[ring.head] = ms;
+        ring.v[ring.head] = vs[i];
+        ring.head = (ring.head + 1) % MAX_POINTS;
+        ring.count = Math.min(ring.count + 1, MAX_POINTS);
+        x.push(ms);
+        y.push(vs[i]);
+      }
+      return { ring, x, y };
+    },
+
+    update(sensors) {
+      const xs = [], ys = [], indices = [];
+      for (const [sid, s] of Object.entries(sensors)) {
+        if (!s.t.length) continue;
+        const { ring, x, y } = this.append(sid, s.t, s.v);
+        if (x.length) {
+          xs.push(x);
+          ys.push(y);
+          indices.push(ring.trace);
+        }
+      }
+      const points = Math.max(0, ...[...this.rings.values()].map(r => r.count));
+      if (!this.ready || (!this.gl && points > GL_POINTS)) {
+        this.gl = this.gl || points > GL_POINTS;
+        this.draw();  // first draw, or the one-off switch to WebGL
+      } else if (indices.length) {
+        Plotly.extendTraces(graphEl, { x: xs, y: ys }, indices, MAX_POINTS);
+      }
+    },
+
+    // Epoch µs to ask /recent from: just past the newest sample held of the
+    // sensor furthest behind, but no more than LAG_US behind the newest one
+    // overall, so a stalled sensor does not drag every poll back to old data
+    since() {
+      if (!this.rings.size) return null;
+      const newest = [...this.rings.values()].map(r => r.newest);
+      return Math.max(Math.min(...newest), Math.max(...newest) - LAG_US) + 1;
+    }
+  };
+
+  function pollChart() {
+    const since = chart.since();
+    const query = (since === null) ? `seconds=${BACKFILL_S}` : `since=${since}`;
+    fetch(`/recent?${query}&max_points=${MAX_POINTS}`)
+      .then(r => r.json())
+      .then(j => {
+        if (Object.keys(j.sensors).length) chart.update(j.sensors);
+      })
+      .catch(err => console.error("Chart fetch error:", err))
+      .finally(() => setTimeout(pollChart, CHART_POLL_MS));
+  }
+  if (typeof Plotly !== 'undefined' && graphEl) pollChart();
+
   // Periodic updates
   setInterval(() => {
     fetch("/status")
@@ -46,25 +211,33 @@ document.addEventListener("DOMContentLoaded", () => {
       .then(j => statusEl.innerText = "Status: " + j.status)
       .catch(err => console.error("Status fetch error:", err));
     
+    const requested = performance.now();
+    let responded;
     fetch("/torque")
       .then(r => r.json())
       .then(j => {
+        responded = performance.now();
         torqueEl.innerText = j.torque_value ?? "--";
         torqueEl.style.color = (j.torque_value > threshInput.value) ? "tomato" : "#00CC66";
-        
-        // Update real-time graph if Plotly is available
-        if (typeof Plotly !== 'undefined' && graphEl) {
-          Plotly.react(graphEl, [{
-            x: [new Date()],
-            y: [j.torque_value],
-            mode:"lines+markers",
-            marker:{ color: (j.torque_value > threshInput.value) ? "tomato" : "#00CC66" }
-          }], { margin:{t:30}, title:"Real-Time Torque" });
-        }
+        // The chart is fed separately from /recent (pollChart)
+        if (j.stamps) reportLatency(j.stamps, requested, responded);
       })
       .catch(err => console.error("Torque fetch error:", err));
   }, 2000);
 
+  // Tell the server when a served sample reached the screen. Measured on
+  // this clock only: half the round trip plus the time until the next paint.
+  function reportLatency(stamps, requested, responded) {
+    requestAnimationFrame(() => {
+      const renderMs = (responded - requested) / 2 + (performance.now() - responded);
+      fetch("/latency", {
+        method: "POST",
+        headers: { "Content-Type": "application/json" },
+        body: JSON.stringify({ stamps: stamps, render_ms: renderMs })
+      }).catch(err => console.error("Latency report error:", err));
+    });
+  }
+
   // Export buttons
   const csvBtn = document.getElementById("export-csv");
   if (csvBtn) {
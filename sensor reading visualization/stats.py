@@ -0,0 +1,71 @@
+"""
+Descriptive statistics for torque sample buffers.
+One implementation shared by the reports, the Qt dashboard and the API,
+so min / max / mean / std / RMS / peak-to-peak agree everywhere.
+"""
+
+import numpy as np
+
+BLOCK_SAMPLES = 1 << 16  # samples reduced per block; small enough to stay in cache
+
+
+def describe(samples):
+    """
+    Return dict(n, mean, std, var, rms, min, max, p2p) for a sample buffer,
+    or None when it is empty. Large buffers are reduced block by block, each
+    block staying in cache while all moments are taken from it, and the
+    per-block moments merged, so memory is read once.
+    """
+    x = np.asarray(samples, dtype=np.float64).ravel()
+    if len(x) == 0:
+        return None
+    acc = None
+    for i in range(0, len(x), BLOCK_SAMPLES):
+        acc = _merge(acc, _block_moments(x[i:i + BLOCK_SAMPLES]))
+    return _finish(*acc)
+
+
+def from_sums(n, total, total_sq, lo, hi):
+    """
+    Same dict as describe() from running power sums, as kept by the store's
+    rollups (n, Σx, Σx², min, max). Returns None when n is 0.
+    """
+    if not n:
+        return None
+    mean = total / n
+    # Clamp the rounding error of Σx²/n - mean² for near-constant signals
+    m2 = max(total_sq - n * mean * mean, 0.0)
+    return _finish(n, mean, m2, lo, hi)
+
+
+def _block_moments(x):
+    mean = x.mean()
+    d = x - mean
+    return len(x), mean, float(np.dot(d, d)), x.min(), x.max()
+
+
+def _merge(a, b):
+    """Combine (n, mean, M2, min, max) of two blocks (Chan et al.)."""
+    if a is None:
+        return b
+    n_a, mean_a, m2_a, lo_a, hi_a = a
+    n_b, mean_b, m2_b, lo_b, hi_b = b
+    n = n_a + n_b
+    delta = mean_b - mean_a
+    mean = mean_a + delta * n_b / n
+    m2 = m2_a + m2_b + delta * delta * n_a * n_b / n
+    return n, mean, m2, min(lo_a, lo_b), max(hi_a, hi_b)
+
+
+def _finish(n, mean, m2, lo, hi):
+    var = m2 / n
+    return {
+        "n": int(n),
+        "mean": float(mean),
+        "std": float(var ** 0.5),
+        "var": float(var),
+        "rms": float((var + mean * mean) ** 0.5),
+        "min": float(lo),
+        "max": float(hi),
+        "p2p": float(hi - lo),
+    }
@@ -7,8 +7,15 @@ const TORQUE_CHARACTERISTIC_UUID = '0000fff1-0000-1000-8000-00805f9b34fb'; // Te
 let torqueSensorDevice = null;
 let torqueCharacteristic = null;
 let torqueChart = null;
-let dataPoints = [];
 const MAX_DATA_POINTS = 100;
+
+// Fixed-size ring of the newest readings, handed to Chart.js as its data
+// array: each sample overwrites one slot at the head, so nothing is
+// shifted or reallocated. The chart sweeps left to right like a scope.
+const ring = {
+    values: Array(MAX_DATA_POINTS).fill(null),
+    head: 0    // next slot to write
+};
 let keepAliveInterval = null;
 
 // Initialize Chart
@@ -20,7 +27,7 @@ function initChart() {
             labels: Array(MAX_DATA_POINTS).fill(''),
             datasets: [{
                 label: 'Torque (Nm)',
-                data: Array(MAX_DATA_POINTS).fill(null),
+                data: ring.values,
                 borderColor: 'rgb(75, 192, 192)',
                 tension: 0.1
             }]
@@ -38,14 +45,13 @@ function initChart() {
     });
 }
 
-// Update chart with new data
+// Update chart with new data: overwrite the slot at the head, then blank
+// the next one so the line breaks between the newest and oldest reading
 function updateChart(value) {
-    dataPoints.push(value);
-    if (dataPoints.length > MAX_DATA_POINTS) {
-        dataPoints.shift();
-    }
-    torqueChart.data.datasets[0].data = dataPoints;
-    torqueChart.update();
+    ring.values[ring.head] = value;
+    ring.head = (ring.head + 1) % MAX_DATA_POINTS;
+    ring.values[ring.head] = null;
+    torqueChart.update('none');
 }
 
 // Fallback polling function
@@ -0,0 +1,1234 @@
+"""
+SQLite storage layer for torque samples.
+Shared by the Flask dashboard (final4.py) and the exporters.
+
+Samples are stored as raw 24-bit ADC counts. Torque is computed on read
+from the versioned calibration table, so a corrected calibration changes
+every past value without rewriting a single row.
+"""
+
+import json
+import os
+import sqlite3
+import time
+from datetime import datetime, timedelta, timezone
+
+import numpy as np
+
+import metrics
+import stats
+
+DB_FILE = "torque_data.db"
+DEFAULT_SENSOR = "default"
+CHUNK_ROWS = 5000  # rows fetched per query when streaming out of the store
+HIST_BIN_COUNTS = 256  # raw ADC counts per histogram bin in torque_hist
+BLOCK_ROWS = 4096  # samples per sensor covered by one torque_blocks entry
+MINUTE_US = 60_000_000  # rollup bucket width; timestamps are int64 epoch microseconds (UTC)
+ALL_SENSORS = "*"  # calibration rows that apply to sensors without their own
+
+_EPOCH = datetime(1970, 1, 1, tzinfo=timezone.utc)
+_current = None  # (db_file, Calibration) cached by current_calibration()
+
+
+def connect(db_file=None):
+    # DB_FILE is looked up per call so tools can point the store elsewhere
+    return sqlite3.connect(db_file or DB_FILE)
+
+
+def init_db(db_file=None, offset=0.0, scale=1.0):
+    """
+    Create or upgrade the schema. offset / scale seed the calibration table
+    on first use and convert calibrated values from older databases back
+    into counts.
+    """
+    conn = connect(db_file)
+    # WAL lets exports read while the BLE loop keeps writing
+    conn.execute("PRAGMA journal_mode=WAL")
+    columns = [row[1] for row in conn.execute("PRAGMA table_info(torque_data)")]
+    if columns and "raw" not in columns:
+        _migrate_legacy(conn, columns, offset, scale)
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS torque_data (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            ts_us INTEGER NOT NULL,
+            raw INTEGER NOT NULL,
+            sensor_id TEXT NOT NULL DEFAULT 'default'
+        )
+    """)
+
+    # torque = (raw - offset) * scale, per sensor ("*" = any), from valid_from_us on
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS calibration (
+            version INTEGER PRIMARY KEY AUTOINCREMENT,
+            sensor_id TEXT NOT NULL,
+            valid_from_us INTEGER NOT NULL,
+            offset REAL NOT NULL,
+            scale REAL NOT NULL,
+            created_us INTEGER NOT NULL,
+            note TEXT
+        )
+    """)
+    if not conn.execute("SELECT 1 FROM calibration LIMIT 1").fetchone():
+        conn.execute(
+            "INSERT INTO calibration (sensor_id, valid_from_us, offset, scale, created_us, note) "
+            "VALUES (?, 0, ?, ?, ?, 'initial')",
+            (ALL_SENSORS, offset, scale, now_us())
+        )
+
+    # Per-minute rollups and a fixed-width histogram of raw counts, kept up
+    # to date on insert, so reports never have to touch raw samples
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS torque_rollup (
+            sensor_id TEXT NOT NULL,
+            bucket INTEGER NOT NULL,
+            n INTEGER NOT NULL,
+            total REAL NOT NULL,
+            total_sq REAL NOT NULL,
+            min_value INTEGER NOT NULL,
+            max_value INTEGER NOT NULL,
+            PRIMARY KEY (sensor_id, bucket)
+        )
+    """)
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS torque_hist (
+            sensor_id TEXT NOT NULL,
+            bin INTEGER NOT NULL,
+            n INTEGER NOT NULL,
+            PRIMARY KEY (sensor_id, bin)
+        )
+    """)
+
+    # Sparse time index: one row per BLOCK_ROWS samples of a sensor with the
+    # id span and timestamp range it covers. Range queries seek it to an id
+    # span instead of scanning the table (see locate()). reach_ts is the
+    # running max of last_ts up to and including the block; a block is
+    # in_order when it starts at or after the reach of all blocks before it,
+    # i.e. unless it holds back-dated /push samples.
+    block_columns = [row[1] for row in conn.execute("PRAGMA table_info(torque_blocks)")]
+    if block_columns and "reach_ts" not in block_columns:
+        conn.execute("DROP TABLE torque_blocks")  # rebuilt by _backfill_blocks below
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS torque_blocks (
+            sensor_id TEXT NOT NULL,
+            first_id INTEGER NOT NULL,
+            last_id INTEGER NOT NULL,
+            first_ts INTEGER NOT NULL,
+            last_ts INTEGER NOT NULL,
+            n INTEGER NOT NULL,
+            reach_ts INTEGER NOT NULL,
+            in_order INTEGER NOT NULL,
+            PRIMARY KEY (sensor_id, first_id)
+        )
+    """)
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_blocks_first_ts ON torque_blocks (sensor_id, first_ts)")
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_blocks_reach ON torque_blocks (sensor_id, reach_ts, first_id)")
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_blocks_order "
+                 "ON torque_blocks (sensor_id, in_order, first_ts, first_id)")
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_torque_sensor ON torque_data (sensor_id, id)")
+
+    # Server-side alert rules (params is JSON, see alerts.py) and the events
+    # they raise; an event's id doubles as its sequence number for pollers
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS alert_rules (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name TEXT NOT NULL UNIQUE,
+            sensor_id TEXT NOT NULL DEFAULT '*',
+            kind TEXT NOT NULL,
+            params TEXT NOT NULL,
+            enabled INTEGER NOT NULL DEFAULT 1
+        )
+    """)
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS alert_events (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            ts_us INTEGER NOT NULL,
+            sensor_id TEXT NOT NULL,
+            rule_id INTEGER NOT NULL,
+            rule_name TEXT NOT NULL,
+            state TEXT NOT NULL,
+            value REAL NOT NULL
+        )
+    """)
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_alert_events_ts ON alert_events (ts_us)")
+
+    # One row per tightening cycle found by cycles.py
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS cycles (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            sensor_id TEXT NOT NULL,
+            start_us INTEGER NOT NULL,
+            end_us INTEGER NOT NULL,
+            peak_torque REAL NOT NULL,
+            peak_us INTEGER NOT NULL,
+            final_torque REAL NOT NULL,
+            overshoot REAL NOT NULL,
+            samples INTEGER NOT NULL
+        )
+    """)
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_cycles_start ON cycles (start_us)")
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_cycles_sensor_start ON cycles (sensor_id, start_us)")
+
+    # Intervals with no data: missing sequence numbers or a dropped link (gaps.py)
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS data_gaps (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            sensor_id TEXT NOT NULL,
+            start_us INTEGER NOT NULL,
+            end_us INTEGER NOT NULL,
+            reason TEXT NOT NULL,
+            lost_frames INTEGER,
+            lost_samples INTEGER
+        )
+    """)
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_data_gaps_start ON data_gaps (start_us)")
+    conn.execute("CREATE INDEX IF NOT EXISTS idx_data_gaps_sensor_start ON data_gaps (sensor_id, start_us)")
+
+    # Known BLE sensors, so a restart or reconnect can connect and subscribe
+    # without scanning or walking the GATT table (ingest.py)
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS ble_devices (
+            sensor_id TEXT PRIMARY KEY,
+            name TEXT,
+            address_type TEXT,
+            service_uuid TEXT,
+            char_uuid TEXT,
+            char_handle INTEGER,
+            updated_us INTEGER NOT NULL
+        )
+    """)
+
+    has_rows = conn.execute("SELECT 1 FROM torque_data LIMIT 1").fetchone()
+    has_rollup = conn.execute("SELECT 1 FROM torque_rollup LIMIT 1").fetchone()
+    has_blocks = conn.execute("SELECT 1 FROM torque_blocks LIMIT 1").fetchone()
+    if has_rows and not has_rollup:
+        _backfill_aggregates(conn)
+    if has_rows and not has_blocks:
+        _backfill_blocks(conn)
+    conn.commit()
+    conn.close()
+    _forget_calibration()
+
+
+def _migrate_legacy(conn, columns, offset, scale):
+    """
+    Rewrite a torque_data table holding calibrated torque_value (and, from the
+    older scripts, DATETIME text timestamps and maybe no sensor_id) into the
+    raw-count schema. Values are turned back into counts with the given
+    calibration, which init_db also records as version 1, so they read back
+    unchanged. The derived tables are dropped and rebuilt by init_db.
+    """
+    sensor = "sensor_id" if "sensor_id" in columns else "'default'"
+    if "ts_us" in columns:
+        ts = "ts_us"
+    else:
+        # strftime('%f') is SS.SSS, so sub-second parts of ISO text survive to the millisecond
+        ts = ("CAST(strftime('%s', timestamp) AS INTEGER) * 1000000"
+              " + CAST(substr(strftime('%f', timestamp), 4) AS INTEGER) * 1000")
+    conn.execute("ALTER TABLE torque_data RENAME TO torque_data_legacy")
+    conn.execute("""
+        CREATE TABLE torque_data (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            ts_us INTEGER NOT NULL,
+            raw INTEGER NOT NULL,
+            sensor_id TEXT NOT NULL DEFAULT 'default'
+        )
+    """)
+    conn.execute(f"""
+        INSERT INTO torque_data (id, ts_us, raw, sensor_id)
+        SELECT id, {ts}, CAST(round(torque_value / ? + ?) AS INTEGER), {sensor}
+        FROM torque_data_legacy WHERE {ts} IS NOT NULL AND torque_value IS NOT NULL
+    """, (scale, offset))
+    conn.execute("DROP TABLE torque_data_legacy")
+    for table in ("torque_rollup", "torque_hist", "torque_blocks"):
+        conn.execute(f"DROP TABLE IF EXISTS {table}")
+
+
+def _backfill_aggregates(conn):
+    """One-off rebuild of the aggregate tables from raw samples."""
+    conn.create_function("hist_bin", 1, _hist_bin, deterministic=True)
+    conn.execute("DELETE FROM torque_rollup")
+    conn.execute("DELETE FROM torque_hist")
+    conn.execute("""
+        INSERT INTO torque_rollup
+        SELECT sensor_id, ts_us - ts_us % ?, COUNT(*), SUM(raw),
+               SUM(CAST(raw AS REAL) * raw), MIN(raw), MAX(raw)
+        FROM torque_data
+        GROUP BY 1, 2
+    """, (MINUTE_US,))
+    conn.execute("""
+        INSERT INTO torque_hist
+        SELECT sensor_id, hist_bin(raw), COUNT(*)
+        FROM torque_data
+        GROUP BY 1, 2
+    """)
+
+
+def _hist_bin(raw):
+    return raw // HIST_BIN_COUNTS
+
+
+def _update_aggregates(conn, rows):
+    """Fold a batch of (ts_us, raw, sensor_id) rows into the aggregates."""
+    rollup = {}
+    hist = {}
+    for ts, val, sensor_id in rows:
+        key = (sensor_id, ts - ts % MINUTE_US)
+        r = rollup.get(key)
+        if r is None:
+            rollup[key] = [1, val, float(val) * val, val, val]
+        else:
+            r[0] += 1
+            r[1] += val
+            r[2] += float(val) * val
+            if val < r[3]:
+                r[3] = val
+            if val > r[4]:
+                r[4] = val
+        key = (sensor_id, _hist_bin(val))
+        hist[key] = hist.get(key, 0) + 1
+
+    conn.executemany("""
+        INSERT INTO torque_rollup VALUES (?, ?, ?, ?, ?, ?, ?)
+        ON CONFLICT (sensor_id, bucket) DO UPDATE SET
+            n = n + excluded.n,
+            total = total + excluded.total,
+            total_sq = total_sq + excluded.total_sq,
+            min_value = MIN(min_value, excluded.min_value),
+            max_value = MAX(max_value, excluded.max_value)
+    """, [(*k, *v) for k, v in rollup.items()])
+    conn.executemany("""
+        INSERT INTO torque_hist VALUES (?, ?, ?)
+        ON CONFLICT (sensor_id, bin) DO UPDATE SET n = n + excluded.n
+    """, [(*k, n) for k, n in hist.items()])
+
+
+def _backfill_blocks(conn):
+    """One-off build of torque_blocks for rows written before it existed."""
+    sensors = [r[0] for r in conn.execute("SELECT DISTINCT sensor_id FROM torque_data")]
+    for sensor_id in sensors:
+        cur = conn.execute(
+            "SELECT id, ts_us FROM torque_data WHERE sensor_id = ? ORDER BY id",
+            (sensor_id,)
+        )
+        while True:
+            items = cur.fetchmany(BLOCK_ROWS)
+            if not items:
+                break
+            _append_blocks(conn, sensor_id, items)
+
+
+def _append_blocks(conn, sensor_id, items):
+    """Extend the sensor's open block, then start new ones, with (id, ts_us) items."""
+    pos = 0
+    blocks = conn.execute(
+        "SELECT first_id, first_ts, last_ts, n, reach_ts FROM torque_blocks "
+        "WHERE sensor_id = ? ORDER BY first_id DESC LIMIT 2",
+        (sensor_id,)
+    ).fetchall()
+    reach = blocks[0][4] if blocks else None
+    if blocks and blocks[0][3] < BLOCK_ROWS:
+        first_id, first_ts, last_ts, n, reach = blocks[0]
+        before = blocks[1][4] if len(blocks) > 1 else None  # reach of the blocks before it
+        take = items[:BLOCK_ROWS - n]
+        stamps = [ts for _, ts in take]
+        first_ts, last_ts = min(first_ts, *stamps), max(last_ts, *stamps)
+        reach = max(reach, last_ts)
+        conn.execute(
+            "UPDATE torque_blocks SET last_id = ?, first_ts = ?, last_ts = ?, n = ?, "
+            "reach_ts = ?, in_order = ? WHERE sensor_id = ? AND first_id = ?",
+            (take[-1][0], first_ts, last_ts, n + len(take), reach,
+             int(before is None or first_ts >= before), sensor_id, first_id)
+        )
+        pos = len(take)
+    while pos < len(items):
+        take = items[pos:pos + BLOCK_ROWS]
+        stamps = [ts for _, ts in take]
+        first_ts, last_ts = min(stamps), max(stamps)
+        in_order = reach is None or first_ts >= reach
+        reach = last_ts if reach is None else max(reach, last_ts)
+        conn.execute(
+            "INSERT INTO torque_blocks VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+            (sensor_id, take[0][0], take[-1][0], first_ts, last_ts, len(take), reach, int(in_order))
+        )
+        pos += len(take)
+
+
+def _update_blocks(conn, rows, last_id):
+    """Index a freshly inserted batch; its ids are last_id - len(rows) + 1 .. last_id."""
+    first_id = last_id - len(rows) + 1
+    per_sensor = {}
+    for i, (ts, _, sensor_id) in enumerate(rows):
+        per_sensor.setdefault(sensor_id, []).append((first_id + i, ts))
+    for sensor_id, items in per_sensor.items():
+        _append_blocks(conn, sensor_id, items)
+
+
+def _block_sensors(conn, sensor_id=None):
+    """Sensors with blocks, one primary-key seek each rather than a DISTINCT scan."""
+    if sensor_id is not None:
+        return [sensor_id]
+    sensors = []
+    row = conn.execute("SELECT MIN(sensor_id) FROM torque_blocks").fetchone()
+    while row is not None and row[0] is not None:
+        sensors.append(row[0])
+        row = conn.execute("SELECT MIN(sensor_id) FROM torque_blocks WHERE sensor_id > ?", (row[0],)).fetchone()
+    return sensors
+
+
+def _locate_sensor(conn, sid, start, end):
+    """(first_id, last_id) of one sensor's blocks that can overlap [start, end], or None."""
+    if start is None:
+        row = conn.execute(
+            "SELECT first_id FROM torque_blocks WHERE sensor_id = ? ORDER BY first_id LIMIT 1", (sid,)
+        ).fetchone()
+    else:
+        # reach_ts only grows with first_id: every block before this one ends before start
+        row = conn.execute(
+            "SELECT first_id FROM torque_blocks WHERE sensor_id = ? AND reach_ts >= ? "
+            "ORDER BY reach_ts, first_id LIMIT 1", (sid, start)
+        ).fetchone()
+    if row is None:
+        return None
+    first = row[0]
+    if end is None:
+        row = conn.execute(
+            "SELECT last_id FROM torque_blocks WHERE sensor_id = ? ORDER BY first_id DESC LIMIT 1", (sid,)
+        ).fetchone()
+        last = row[0]
+    else:
+        # In-order blocks start no earlier than any block before them, so
+        # first_ts grows with first_id among them: the last one starting by
+        # end is one seek. Back-dated blocks are few and checked one by one.
+        row = conn.execute(
+            "SELECT last_id FROM torque_blocks WHERE sensor_id = ? AND in_order = 1 AND first_ts <= ? "
+            "ORDER BY first_ts DESC, first_id DESC LIMIT 1", (sid, end)
+        ).fetchone()
+        last = row[0] if row else None
+        row = conn.execute(
+            "SELECT MAX(last_id) FROM torque_blocks WHERE sensor_id = ? AND in_order = 0 "
+            "AND first_ts <= ? AND last_ts >= ?", (sid, end, -2**63 if start is None else start)
+        ).fetchone()
+        if row[0] is not None and (last is None or row[0] > last):
+            last = row[0]
+    if last is None or last < first:
+        return None
+    return first, last
+
+
+def locate(conn, start=None, end=None, sensor_id=None):
+    """
+    Map a time range to the (first_id, last_id) span that can hold matching
+    rows, with a few index seeks per sensor on torque_blocks however many
+    blocks there are. Back-dated /push samples are found too: see the
+    reach_ts / in_order columns. Returns None when no block overlaps the range.
+    """
+    lo = hi = None
+    for sid in _block_sensors(conn, sensor_id):
+        span = _locate_sensor(conn, sid, start, end)
+        if span is None:
+            continue
+        lo = span[0] if lo is None else min(lo, span[0])
+        hi = span[1] if hi is None else max(hi, span[1])
+    if lo is None:
+        return None
+    return lo, hi
+
+
+def time_bounds(start=None, end=None, sensor_id=None):
+    """
+    (first_ts, last_ts) that the stored samples in [start, end] can span,
+    from torque_blocks without touching raw rows; a given bound is kept as
+    is. Returns None when no samples match.
+    """
+    conn = connect()
+    try:
+        first = last = None
+        for sid in _block_sensors(conn, sensor_id):
+            if _locate_sensor(conn, sid, start, end) is None:
+                continue
+            lo = conn.execute(
+                "SELECT first_ts FROM torque_blocks WHERE sensor_id = ? ORDER BY first_ts LIMIT 1", (sid,)
+            ).fetchone()[0]
+            hi = conn.execute(
+                "SELECT reach_ts FROM torque_blocks WHERE sensor_id = ? ORDER BY first_id DESC LIMIT 1", (sid,)
+            ).fetchone()[0]
+            first = lo if first is None else min(first, lo)
+            last = hi if last is None else max(last, hi)
+    finally:
+        conn.close()
+    if first is None:
+        return None
+    first = first if start is None else max(start, first)
+    last = last if end is None else min(end, last)
+    return (first, last) if first <= last else None
+
+
+def now_us():
+    """Current time as int64 microseconds since the Unix epoch."""
+    return time.time_ns() // 1000
+
+
+def to_us(value):
+    """
+    Parse a timestamp given as epoch microseconds (int or digit string) or
+    ISO8601 text into epoch microseconds. Naive ISO times are taken as UTC.
+    """
+    if value is None or isinstance(value, int):
+        return value
+    value = str(value).strip()
+    if value.lstrip("-").isdigit():
+        return int(value)
+    dt = datetime.fromisoformat(value)
+    if dt.tzinfo is None:
+        dt = dt.replace(tzinfo=timezone.utc)
+    delta = dt - _EPOCH
+    return (delta.days * 86400 + delta.seconds) * 1_000_000 + delta.microseconds
+
+
+def format_us(ts_us):
+    """Render epoch microseconds as ISO8601 UTC text, for presentation only."""
+    return (_EPOCH + timedelta(microseconds=ts_us)).isoformat(timespec="microseconds")
+
+
+def save_batch(rows):
+    """Insert (ts_us, raw, sensor_id) rows in a single transaction."""
+    if not rows:
+        return
+    started = time.perf_counter()
+    conn = connect()
+    conn.executemany(
+        "INSERT INTO torque_data (ts_us, raw, sensor_id) VALUES (?, ?, ?)",
+        rows
+    )
+    last_id = conn.execute("SELECT last_insert_rowid()").fetchone()[0]
+    _update_blocks(conn, rows, last_id)
+    _update_aggregates(conn, rows)
+    conn.commit()
+    conn.close()
+    metrics.COMMIT_SECONDS.observe(time.perf_counter() - started)
+
+
+def db_size_bytes(db_file=None):
+    """Size of the database file plus its write-ahead log."""
+    path = db_file or DB_FILE
+    return sum(os.path.getsize(p) for p in (path, path + "-wal") if os.path.exists(p))
+
+
+def save_val(raw, sensor_id=DEFAULT_SENSOR, ts_us=None):
+    save_batch([(now_us() if ts_us is None else ts_us, raw, sensor_id)])
+
+
+# ── Calibration ──
+
+class Calibration:
+    """
+    Snapshot of the calibration table, laid out for vectorized lookup.
+    For each sample, the row with the latest valid_from_us at or before its
+    timestamp applies, the newest version winning ties. A sensor's own rows
+    take over from the "*" rows at the first of their valid_from_us.
+    A pinned version applies to everything.
+    """
+
+    def __init__(self, rows, version=None):
+        # rows: (version, sensor_id, valid_from_us, offset, scale)
+        self.pinned = None
+        if version is not None:
+            match = [r for r in rows if r[0] == version]
+            if not match:
+                raise LookupError(f"Unknown calibration version {version}")
+            self.pinned = (match[0][3], match[0][4])
+
+        per_sensor = {}
+        for _, sensor_id, valid_from, offset, scale in sorted(rows, key=lambda r: (r[1], r[2], r[0])):
+            entries = per_sensor.setdefault(sensor_id, [])
+            if entries and entries[-1][0] == valid_from:
+                entries[-1] = (valid_from, offset, scale)
+            else:
+                entries.append((valid_from, offset, scale))
+        shared = per_sensor.pop(ALL_SENSORS, [])
+        self._tables = {
+            sensor_id: self._table([e for e in shared if e[0] < entries[0][0]] + entries)
+            for sensor_id, entries in per_sensor.items()
+        }
+        self._shared = self._table(shared) if shared else None
+
+    @staticmethod
+    def _table(entries):
+        return (
+            np.array([e[0] for e in entries], dtype=np.int64),
+            np.array([e[1] for e in entries], dtype=np.float64),
+            np.array([e[2] for e in entries], dtype=np.float64),
+        )
+
+    def params(self, sensor_id, ts_us):
+        """(offset, scale) arrays for one sensor's array of timestamps."""
+        ts_us = np.asarray(ts_us, dtype=np.int64)
+        if self.pinned is not None:
+            return np.full(ts_us.shape, self.pinned[0]), np.full(ts_us.shape, self.pinned[1])
+        table = self._tables.get(sensor_id, self._shared)
+        if table is None:
+            return np.zeros(ts_us.shape), np.ones(ts_us.shape)
+        valid_from, offset, scale = table
+        # Samples older than the first version use the first version
+        idx = np.searchsorted(valid_from, ts_us, side="right") - 1
+        np.maximum(idx, 0, out=idx)
+        return offset[idx], scale[idx]
+
+    def current(self, sensor_id):
+        """(offset, scale) in force now for a sensor, as plain floats."""
+        offset, scale = self.params(sensor_id, [now_us()])
+        return float(offset[0]), float(scale[0])
+
+    def apply(self, sensor_ids, ts_us, raw):
+        """Torque for parallel sequences of sensor id, timestamp and raw count."""
+        ts_us = np.asarray(ts_us, dtype=np.int64)
+        raw = np.asarray(raw, dtype=np.float64)
+        sensors = set(sensor_ids)
+        if len(sensors) == 1:
+            offset, scale = self.params(sensors.pop(), ts_us)
+            return (raw - offset) * scale
+        sensor_ids = np.asarray(sensor_ids, dtype=object)
+        out = np.empty(raw.shape)
+        for sensor_id in sensors:
+            mask = sensor_ids == sensor_id
+            offset, scale = self.params(sensor_id, ts_us[mask])
+            out[mask] = (raw[mask] - offset) * scale
+        return out
+
+    def to_raw(self, sensor_id, ts_us, torque):
+        """Invert the calibration for one value, e.g. for pushed torque readings."""
+        offset, scale = self.params(sensor_id, [ts_us])
+        return int(round(torque / scale[0] + offset[0]))
+
+
+def load_calibration(version=None):
+    conn = connect()
+    rows = conn.execute(
+        "SELECT version, sensor_id, valid_from_us, offset, scale FROM calibration"
+    ).fetchall()
+    conn.close()
+    return Calibration(rows, version)
+
+
+def current_calibration():
+    """
+    load_calibration() for the ingest hot path, cached until this process
+    records a new version with add_calibration().
+    """
+    global _current
+    cached = _current
+    if cached is None or cached[0] != DB_FILE:
+        cached = _current = (DB_FILE, load_calibration())
+    return cached[1]
+
+
+def _forget_calibration():
+    global _current
+    _current = None
+
+
+def list_calibrations():
+    conn = connect()
+    rows = conn.execute(
+        "SELECT version, sensor_id, valid_from_us, offset, scale, created_us, note "
+        "FROM calibration ORDER BY version"
+    ).fetchall()
+    conn.close()
+    keys = ("version", "sensor_id", "valid_from_us", "offset", "scale", "created_us", "note")
+    return [dict(zip(keys, row)) for row in rows]
+
+
+def add_calibration(offset, scale, sensor_id=ALL_SENSORS, valid_from_us=0, note=None):
+    """
+    Record a new calibration version and return its number. Reusing an
+    existing valid_from_us supersedes that version for all past samples.
+    """
+    if not scale:
+        raise ValueError("Calibration scale must be non-zero")
+    conn = connect()
+    cur = conn.execute(
+        "INSERT INTO calibration (sensor_id, valid_from_us, offset, scale, created_us, note) "
+        "VALUES (?, ?, ?, ?, ?, ?)",
+        (sensor_id, valid_from_us, offset, scale, now_us(), note)
+    )
+    conn.commit()
+    conn.close()
+    _forget_calibration()
+    return cur.lastrowid
+
+
+# ── Reads ──
+
+def latest():
+    """Return (ts_us, raw, torque_value) of the newest sample, or None."""
+    conn = connect()
+    row = conn.execute(
+        "SELECT ts_us, raw, sensor_id FROM torque_data ORDER BY id DESC LIMIT 1"
+    ).fetchone()
+    conn.close()
+    if row is None:
+        return None
+    ts, raw, sensor_id = row
+    torque = load_calibration().apply([sensor_id], [ts], [raw])[0]
+    return ts, raw, float(torque)
+
+
+def recent(limit=50, sensor_id=None):
+    """Return the newest `limit` samples as (ts_us, torque) arrays, oldest first."""
+    conn = connect()
+    if sensor_id is None:
+        rows = conn.execute(
+            "SELECT ts_us, raw, sensor_id FROM torque_data ORDER BY id DESC LIMIT ?",
+            (limit,)
+        ).fetchall()
+    else:
+        rows = conn.execute(
+            "SELECT ts_us, raw, sensor_id FROM torque_data WHERE sensor_id = ? "
+            "ORDER BY id DESC LIMIT ?",
+            (sensor_id, limit)
+        ).fetchall()
+    conn.close()
+    rows.reverse()
+    if not rows:
+        return np.empty(0, dtype=np.int64), np.empty(0)
+    ts, raw, sensors = zip(*rows)
+    ts = np.array(ts, dtype=np.int64)
+    return ts, load_calibration().apply(sensors, ts, raw)
+
+
+def newer_than(last_id=0, limit=CHUNK_ROWS, sensor_id=None):
+    """
+    For incremental readers: the newest `limit` samples with id > last_id as
+    (ids, ts_us, torque) arrays, oldest first. One primary-key range seek,
+    so the cost depends on `limit`, not on the size of the table.
+    """
+    conn = connect()
+    if sensor_id is None:
+        rows = conn.execute(
+            "SELECT id, ts_us, raw, sensor_id FROM torque_data WHERE id > ? ORDER BY id DESC LIMIT ?",
+            (last_id, limit)
+        ).fetchall()
+    else:
+        rows = conn.execute(
+            "SELECT id, ts_us, raw, sensor_id FROM torque_data WHERE id > ? AND sensor_id = ? "
+            "ORDER BY id DESC LIMIT ?",
+            (last_id, sensor_id, limit)
+        ).fetchall()
+    conn.close()
+    if not rows:
+        return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.int64), np.empty(0)
+    rows.reverse()
+    ids, ts, raw, sensors = zip(*rows)
+    ts = np.array(ts, dtype=np.int64)
+    return np.array(ids, dtype=np.int64), ts, load_calibration().apply(sensors, ts, raw)
+
+
+def iter_chunks(start=None, end=None, sensor_id=None, chunk_rows=CHUNK_ROWS):
+    """
+    Yield lists of (id, ts_us, raw, sensor_id) rows in id order.
+    start / end are inclusive epoch-microsecond bounds.
+    The time range is first narrowed to an id span with locate(); each chunk
+    is then a separate keyset query over that span, so no read transaction is
+    held open between chunks and memory stays bounded by chunk_rows.
+    """
+    conn = connect()
+    try:
+        span = locate(conn, start, end, sensor_id)
+        if span is None:
+            return
+        where = ["id > ?", "id <= ?"]
+        params = [span[1]]
+        if start is not None:
+            where.append("ts_us >= ?")
+            params.append(start)
+        if end is not None:
+            where.append("ts_us <= ?")
+            params.append(end)
+        if sensor_id is not None:
+            where.append("sensor_id = ?")
+            params.append(sensor_id)
+        sql = (
+            "SELECT id, ts_us, raw, sensor_id FROM torque_data "
+            f"WHERE {' AND '.join(where)} ORDER BY id LIMIT ?"
+        )
+
+        last_id = span[0] - 1
+        while True:
+            rows = conn.execute(sql, [last_id, *params, chunk_rows]).fetchall()
+            if not rows:
+                return
+            yield rows
+            if len(rows) < chunk_rows:
+                return
+            last_id = rows[-1][0]
+    finally:
+        conn.close()
+
+
+def _rollup_filter(start, end, sensor_id):
+    where = ["1"]
+    params = []
+    # Rollups are per minute, so bounds are truncated to the minute
+    if start is not None:
+        where.append("bucket >= ?")
+        params.append(start - start % MINUTE_US)
+    if end is not None:
+        where.append("bucket <= ?")
+        params.append(end - end % MINUTE_US)
+    if sensor_id is not None:
+        where.append("sensor_id = ?")
+        params.append(sensor_id)
+    return " AND ".join(where), params
+
+
+def calibrated_chunks(start=None, end=None, sensor_id=None, calibration=None,
+                      chunk_rows=CHUNK_ROWS):
+    """
+    iter_chunks() with calibration applied: yields (ids, ts_us, raw, torque,
+    sensor_ids) numpy columns per chunk. calibration defaults to the current
+    table; pass load_calibration(version) to reproduce an older one.
+    """
+    if calibration is None:
+        calibration = load_calibration()
+    for rows in iter_chunks(start, end, sensor_id, chunk_rows):
+        ids, ts, raw, sensors = zip(*rows)
+        ts = np.array(ts, dtype=np.int64)
+        raw = np.array(raw, dtype=np.int64)
+        yield (np.array(ids, dtype=np.int64), ts, raw,
+               calibration.apply(sensors, ts, raw), sensors)
+
+
+def _calibrated_rollups(start, end, sensor_id, calibration):
+    """
+    Minute rollups converted to torque as (bucket, n, total, total_sq, min, max)
+    columns. Each (sensor, minute) row is calibrated with the version in force
+    at the start of its minute; sums of counts map linearly onto sums of torque.
+    """
+    if calibration is None:
+        calibration = load_calibration()
+    where, params = _rollup_filter(start, end, sensor_id)
+    conn = connect()
+    rows = conn.execute(
+        "SELECT sensor_id, bucket, n, total, total_sq, min_value, max_value "
+        f"FROM torque_rollup WHERE {where} ORDER BY bucket",
+        params
+    ).fetchall()
+    conn.close()
+    if not rows:
+        return None
+    sensors, bucket, n, total, total_sq, lo, hi = zip(*rows)
+    bucket = np.array(bucket, dtype=np.int64)
+    n = np.array(n, dtype=np.float64)
+    total = np.array(total, dtype=np.float64)
+    total_sq = np.array(total_sq, dtype=np.float64)
+    offset = np.empty(len(rows))
+    scale = np.empty(len(rows))
+    sensors = np.array(sensors, dtype=object)
+    for sid in set(sensors):
+        mask = sensors == sid
+        offset[mask], scale[mask] = calibration.params(sid, bucket[mask])
+
+    lo = (np.array(lo, dtype=np.float64) - offset) * scale
+    hi = (np.array(hi, dtype=np.float64) - offset) * scale
+    return {
+        "sensor_id": sensors,
+        "bucket": bucket,
+        "n": n,
+        "total": (total - n * offset) * scale,
+        "total_sq": (total_sq - 2 * offset * total + n * offset * offset) * scale * scale,
+        # A negative scale turns the smallest count into the largest torque
+        "min": np.minimum(lo, hi),
+        "max": np.maximum(lo, hi),
+    }
+
+
+def summary(start=None, end=None, sensor_id=None, calibration=None):
+    """
+    Return stats.describe()-style dict(n, mean, std, var, rms, min, max, p2p)
+    plus first / last bucket from the rollups, or None.
+    """
+    r = _calibrated_rollups(start, end, sensor_id, calibration)
+    if r is None:
+        return None
+    result = stats.from_sums(r["n"].sum(), r["total"].sum(), r["total_sq"].sum(),
+                             r["min"].min(), r["max"].max())
+    result.update(first=int(r["bucket"][0]), last=int(r["bucket"][-1]))
+    return result
+
+
+def trend(start=None, end=None, sensor_id=None, max_points=500, calibration=None):
+    """
+    Downsampled (bucket_us, mean, min, max) series built from the minute rollups,
+    merging neighbouring minutes so at most max_points points come back.
+    """
+    r = _calibrated_rollups(start, end, sensor_id, calibration)
+    if r is None:
+        return []
+    # Rows are ordered by bucket; fold sensors sharing a minute, then merge minutes
+    buckets, starts = np.unique(r["bucket"], return_index=True)
+    step = max(1, -(-len(buckets) // max_points))
+    starts = starts[::step]
+    n = np.add.reduceat(r["n"], starts)
+    total = np.add.reduceat(r["total"], starts)
+    lo = np.minimum.reduceat(r["min"], starts)
+    hi = np.maximum.reduceat(r["max"], starts)
+    return [
+        (int(b), float(t / c), float(mn), float(mx))
+        for b, c, t, mn, mx in zip(buckets[::step], n, total, lo, hi)
+    ]
+
+
+def buckets(start, end, sensor_id=None, step_us=MINUTE_US, calibration=None):
+    """
+    Downsampled (bucket_us, mean, min, max) series over [start, end] with
+    one point per step_us bucket that holds samples, for spans shorter than
+    the minute rollups resolve. Aggregated in SQL over the locate()d id span,
+    so only one row per (sensor, bucket) leaves SQLite; each is calibrated
+    with the version in force at the start of its bucket, as in the rollups.
+    """
+    if calibration is None:
+        calibration = load_calibration()
+    origin = start - start % step_us
+    where = ["id >= ?", "id <= ?", "ts_us >= ?", "ts_us <= ?"]
+    params = [origin, step_us]
+    conn = connect()
+    try:
+        span = locate(conn, start, end, sensor_id)
+        if span is None:
+            return []
+        params += [span[0], span[1], start, end]
+        if sensor_id is not None:
+            where.append("sensor_id = ?")
+            params.append(sensor_id)
+        rows = conn.execute(
+            "SELECT sensor_id, (ts_us - ?) / ? AS k, COUNT(*), SUM(raw), MIN(raw), MAX(raw) "
+            f"FROM torque_data WHERE {' AND '.join(where)} GROUP BY sensor_id, k",
+            params
+        ).fetchall()
+    finally:
+        conn.close()
+    if not rows:
+        return []
+    sensors, k, n, total, lo, hi = zip(*rows)
+    bucket = origin + np.array(k, dtype=np.int64) * step_us
+    n = np.array(n, dtype=np.float64)
+    offset = np.empty(len(rows))
+    scale = np.empty(len(rows))
+    sensors = np.array(sensors, dtype=object)
+    for sid in set(sensors):
+        mask = sensors == sid
+        offset[mask], scale[mask] = calibration.params(sid, bucket[mask])
+    total = (np.array(total, dtype=np.float64) - n * offset) * scale
+    lo = (np.array(lo, dtype=np.float64) - offset) * scale
+    hi = (np.array(hi, dtype=np.float64) - offset) * scale
+    lo, hi = np.minimum(lo, hi), np.maximum(lo, hi)
+
+    # Fold sensors sharing a bucket
+    buckets_us, inverse = np.unique(bucket, return_inverse=True)
+    count = np.bincount(inverse, weights=n)
+    total = np.bincount(inverse, weights=total)
+    low = np.full(len(buckets_us), np.inf)
+    high = np.full(len(buckets_us), -np.inf)
+    np.minimum.at(low, inverse, lo)
+    np.maximum.at(high, inverse, hi)
+    return [
+        (int(b), float(t / c), float(mn), float(mx))
+        for b, c, t, mn, mx in zip(buckets_us, count, total, low, high)
+    ]
+
+
+def overview(start=None, end=None, sensor_id=None, max_points=500, calibration=None):
+    """
+    At most about max_points (bucket_us, mean, min, max) points covering
+    [start, end]: minute rollups (trend()) when the range is long enough for
+    them, otherwise buckets() of the width that yields max_points. Returns
+    (resolution, step_us, points) with resolution "rollup" or "bucket".
+    """
+    bounds = time_bounds(start, end, sensor_id)
+    if bounds is None:
+        return "bucket", None, []
+    step_us = max(1, -(-(bounds[1] - bounds[0] + 1) // max(1, max_points)))
+    if step_us >= MINUTE_US:
+        return "rollup", None, trend(start, end, sensor_id, max_points, calibration)
+    return "bucket", step_us, buckets(bounds[0], bounds[1], sensor_id, step_us, calibration)
+
+
+def histogram(sensor_id=None, calibration=None):
+    """
+    Return [(low, high, count), ...] over all history, sorted by torque. Bins
+    are HIST_BIN_COUNTS raw counts wide, converted with each sensor's current
+    calibration.
+    """
+    if calibration is None:
+        calibration = load_calibration()
+    conn = connect()
+    if sensor_id is None:
+        rows = conn.execute("SELECT sensor_id, bin, n FROM torque_hist").fetchall()
+    else:
+        rows = conn.execute(
+            "SELECT sensor_id, bin, n FROM torque_hist WHERE sensor_id = ?",
+            (sensor_id,)
+        ).fetchall()
+    conn.close()
+    out = []
+    for sid, b, n in rows:
+        offset, scale = calibration.current(sid)
+        a = (b * HIST_BIN_COUNTS - offset) * scale
+        z = ((b + 1) * HIST_BIN_COUNTS - offset) * scale
+        out.append((min(a, z), max(a, z), n))
+    out.sort()
+    return out
+
+
+def peaks(start=None, end=None, sensor_id=None, limit=10, calibration=None):
+    """Return the minutes holding the highest torque as (bucket_us, sensor_id, max_value)."""
+    r = _calibrated_rollups(start, end, sensor_id, calibration)
+    if r is None:
+        return []
+    order = np.argsort(-r["max"], kind="stable")[:limit]
+    return [(int(r["bucket"][i]), r["sensor_id"][i], float(r["max"][i])) for i in order]
+
+
+# ── Alerts ──
+
+_RULE_KEYS = ("id", "name", "sensor_id", "kind", "params", "enabled")
+_EVENT_KEYS = ("seq", "ts_us", "sensor_id", "rule_id", "rule_name", "state", "value")
+
+
+def list_alert_rules(enabled_only=False):
+    conn = connect()
+    rows = conn.execute(
+        "SELECT id, name, sensor_id, kind, params, enabled FROM alert_rules "
+        + ("WHERE enabled = 1 " if enabled_only else "") + "ORDER BY id"
+    ).fetchall()
+    conn.close()
+    rules = []
+    for row in rows:
+        rule = dict(zip(_RULE_KEYS, row))
+        rule["params"] = json.loads(rule["params"])
+        rule["enabled"] = bool(rule["enabled"])
+        rules.append(rule)
+    return rules
+
+
+def save_alert_rule(name, kind, params, sensor_id=ALL_SENSORS, enabled=True):
+    """Create or replace the rule called `name`; returns its id."""
+    conn = connect()
+    conn.execute(
+        "INSERT INTO alert_rules (name, sensor_id, kind, params, enabled) VALUES (?, ?, ?, ?, ?) "
+        "ON CONFLICT(name) DO UPDATE SET sensor_id = excluded.sensor_id, kind = excluded.kind, "
+        "params = excluded.params, enabled = excluded.enabled",
+        (name, sensor_id, kind, json.dumps(params), int(enabled))
+    )
+    rule_id = conn.execute("SELECT id FROM alert_rules WHERE name = ?", (name,)).fetchone()[0]
+    conn.commit()
+    conn.close()
+    return rule_id
+
+
+def delete_alert_rule(rule_id):
+    conn = connect()
+    deleted = conn.execute("DELETE FROM alert_rules WHERE id = ?", (rule_id,)).rowcount
+    conn.commit()
+    conn.close()
+    return bool(deleted)
+
+
+def save_alert_events(events):
+    """Insert (ts_us, sensor_id, rule_id, rule_name, state, value) rows; returns the last seq."""
+    conn = connect()
+    conn.executemany(
+        "INSERT INTO alert_events (ts_us, sensor_id, rule_id, rule_name, state, value) "
+        "VALUES (?, ?, ?, ?, ?, ?)",
+        events
+    )
+    last = conn.execute("SELECT MAX(id) FROM alert_events").fetchone()[0]
+    conn.commit()
+    conn.close()
+    return last
+
+
+def alert_events(after_seq=0, start=None, end=None, sensor_id=None, limit=500):
+    """Events with seq > after_seq (and optional time / sensor filters), oldest first."""
+    where = ["id > ?"]
+    params = [after_seq]
+    if start is not None:
+        where.append("ts_us >= ?")
+        params.append(start)
+    if end is not None:
+        where.append("ts_us <= ?")
+        params.append(end)
+    if sensor_id is not None:
+        where.append("sensor_id = ?")
+        params.append(sensor_id)
+    conn = connect()
+    rows = conn.execute(
+        "SELECT id, ts_us, sensor_id, rule_id, rule_name, state, value FROM alert_events "
+        f"WHERE {' AND '.join(where)} ORDER BY id LIMIT ?",
+        [*params, limit]
+    ).fetchall()
+    conn.close()
+    return [dict(zip(_EVENT_KEYS, row)) for row in rows]
+
+
+def last_alert_seq():
+    conn = connect()
+    last = conn.execute("SELECT MAX(id) FROM alert_events").fetchone()[0]
+    conn.close()
+    return last or 0
+
+
+# ── Cycles ──
+
+_CYCLE_KEYS = ("id", "sensor_id", "start_us", "end_us", "peak_torque", "peak_us",
+               "final_torque", "overshoot", "samples")
+
+
+def save_cycles(rows):
+    """Insert (sensor_id, start_us, end_us, peak, peak_us, final, overshoot, samples) rows."""
+    conn = connect()
+    conn.executemany(
+        "INSERT INTO cycles (sensor_id, start_us, end_us, peak_torque, peak_us, "
+        "final_torque, overshoot, samples) VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        rows
+    )
+    conn.commit()
+    conn.close()
+
+
+def list_cycles(start=None, end=None, sensor_id=None, min_peak=None, max_peak=None,
+                after_id=0, limit=1000):
+    """Cycles starting within [start, end] in the order they finished; page with after_id."""
+    where = ["id > ?"]
+    params = [after_id]
+    if start is not None:
+        where.append("start_us >= ?")
+        params.append(start)
+    if end is not None:
+        where.append("start_us <= ?")
+        params.append(end)
+    if sensor_id is not None:
+        where.append("sensor_id = ?")
+        params.append(sensor_id)
+    if min_peak is not None:
+        where.append("peak_torque >= ?")
+        params.append(min_peak)
+    if max_peak is not None:
+        where.append("peak_torque <= ?")
+        params.append(max_peak)
+    conn = connect()
+    rows = conn.execute(
+        f"SELECT {', '.join(_CYCLE_KEYS)} FROM cycles "
+        f"WHERE {' AND '.join(where)} ORDER BY id LIMIT ?",
+        [*params, limit]
+    ).fetchall()
+    conn.close()
+    return [dict(zip(_CYCLE_KEYS, row)) for row in rows]
+
+
+# ── Data gaps ──
+
+_GAP_KEYS = ("id", "sensor_id", "start_us", "end_us", "reason", "lost_frames", "lost_samples")
+
+
+def save_gaps(rows):
+    """Insert (sensor_id, start_us, end_us, reason, lost_frames, lost_samples) rows."""
+    conn = connect()
+    conn.executemany(
+        "INSERT INTO data_gaps (sensor_id, start_us, end_us, reason, lost_frames, lost_samples) "
+        "VALUES (?, ?, ?, ?, ?, ?)",
+        rows
+    )
+    conn.commit()
+    conn.close()
+
+
+def list_gaps(start=None, end=None, sensor_id=None, limit=10000):
+    """Gaps overlapping [start, end], oldest first. lost_* are None for link gaps."""
+    where = ["1"]
+    params = []
+    if end is not None:
+        where.append("start_us <= ?")
+        params.append(end)
+    if start is not None:
+        where.append("end_us >= ?")
+        params.append(start)
+    if sensor_id is not None:
+        where.append("sensor_id = ?")
+        params.append(sensor_id)
+    conn = connect()
+    rows = conn.execute(
+        f"SELECT {', '.join(_GAP_KEYS)} FROM data_gaps "
+        f"WHERE {' AND '.join(where)} ORDER BY start_us, id LIMIT ?",
+        [*params, limit]
+    ).fetchall()
+    conn.close()
+    return [dict(zip(_GAP_KEYS, row)) for row in rows]
+
+
+def gap_summary(start=None, end=None, sensor_id=None):
+    """
+    dict(gaps, lost_frames, lost_samples, missing_us) over [start, end].
+    missing_us is the union of the gap intervals (per sensor, clipped to the
+    range), so overlapping sequence and link gaps are not counted twice.
+    """
+    gaps = list_gaps(start, end, sensor_id)
+    missing = 0
+    for sid in {g["sensor_id"] for g in gaps}:
+        spans = sorted((max(g["start_us"], start if start is not None else g["start_us"]),
+                        min(g["end_us"], end if end is not None else g["end_us"]))
+                       for g in gaps if g["sensor_id"] == sid)
+        cur_start, cur_end = spans[0]
+        for a, b in spans[1:]:
+            if a > cur_end:
+                missing += cur_end - cur_start
+                cur_start, cur_end = a, b
+            else:
+                cur_end = max(cur_end, b)
+        missing += cur_end - cur_start
+    return {
+        "gaps": len(gaps),
+        "lost_frames": sum(g["lost_frames"] or 0 for g in gaps),
+        "lost_samples": sum(g["lost_samples"] or 0 for g in gaps),
+        "missing_us": int(missing),
+    }
+
+
+# ── Known BLE devices ──
+
+_DEVICE_KEYS = ("sensor_id", "name", "address_type", "service_uuid", "char_uuid", "char_handle", "updated_us")
+
+
+def list_devices():
+    conn = connect()
+    rows = conn.execute(f"SELECT {', '.join(_DEVICE_KEYS)} FROM ble_devices ORDER BY sensor_id").fetchall()
+    conn.close()
+    return [dict(zip(_DEVICE_KEYS, row)) for row in rows]
+
+
+def save_device(sensor_id, name=None, address_type=None, service_uuid=None, char_uuid=None, char_handle=None):
+    """
+    Create or update a known device. None leaves a stored name / address type
+    as it was; the characteristic fields are always replaced, so passing
+    char_handle=None forgets a handle that stopped working.
+    """
+    conn = connect()
+    conn.execute(
+        "INSERT INTO ble_devices (sensor_id, name, address_type, service_uuid, char_uuid, char_handle, updated_us) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT(sensor_id) DO UPDATE SET name = coalesce(excluded.name, name), "
+        "address_type = coalesce(excluded.address_type, address_type), "
+        "service_uuid = excluded.service_uuid, char_uuid = excluded.char_uuid, "
+        "char_handle = excluded.char_handle, updated_us = excluded.updated_us",
+        (sensor_id, name, address_type, service_uuid, char_uuid, char_handle, now_us())
+    )
+    conn.commit()
+    conn.close()
+
+
+def forget_device(sensor_id):
+    conn = connect()
+    deleted = conn.execute("DELETE FROM ble_devices WHERE sensor_id = ?", (sensor_id,)).rowcount
+    conn.commit()
+    conn.close()
+    return bool(deleted)
@@ -1,13 +1,9 @@
 import sys
-import sqlite3
-import pandas as pd
 import numpy as np
 import pyqtgraph as pg
 from pyqtgraph.graphicsItems.DateAxisItem import DateAxisItem
 import qdarkstyle
-import matplotlib.pyplot as plt
 import asyncio
-import threading
 import json
 
 from bleak import BleakClient, BleakScanner
@@ -19,11 +15,18 @@ from PyQt6.QtWidgets import (
     QVBoxLayout, QWidget, QSlider, QSplitter, QHBoxLayout
 )
 from PyQt6.QtCore import QTimer, Qt
-from reportlab.pdfgen import canvas
+
+import ble_loop
+import torque_store
+import exporters
+import stats
+from ring import SampleRing
 
 # — User settings —
-DB_FILE = "torque_data.db"
+DB_FILE = torque_store.DB_FILE
 THRESHOLD_DEFAULT = 100  # N·cm
+LIVE_POINTS = 2000       # newest samples on the live plot, held in a preallocated ring
+HISTORY_POINTS = 1000    # points fetched per history redraw, whatever the zoom
 
 # Load config.json
 try:
@@ -44,6 +47,10 @@ class TorqueDashboard(QMainWindow):
         self.setWindowTitle("Torque Sensor Dashboard")
         self.setGeometry(200, 200, 900, 600)
         self.connected_device = None
+        self.live = SampleRing(LIVE_POINTS)
+        self.last_id = 0  # newest torque_data id already in the live ring
+        self.history = None  # history plot window, made on first use
+        self._tasks = {}  # coroutine function name -> its future on the shared BLE loop
 
         # --- Status & Torque Labels (side by side) ---
         self.status_label = QLabel("Status: Disconnected", self)
@@ -60,6 +67,8 @@ class TorqueDashboard(QMainWindow):
         self.graph = pg.PlotWidget(axisItems={"bottom": date_axis})
         self.graph.setBackground("black")
         self.graph.setTitle("Real-Time Torque", color="white", size="14pt")
+        # One curve, updated in place on every tick (never cleared and re-added)
+        self.curve = self.graph.plot(pen=pg.mkPen("green", width=2))
 
         # --- Threshold slider ---
         self.slider = QSlider(Qt.Orientation.Horizontal)
@@ -67,6 +76,8 @@ class TorqueDashboard(QMainWindow):
         self.slider.setValue(THRESHOLD_DEFAULT)
         self.slider.valueChanged.connect(self.on_threshold_changed)
         self.threshold_label = QLabel(f"Alert Threshold: {THRESHOLD_DEFAULT} N·cm")
+        self.stats_label = QLabel("Window: --")
+        self.stats_label.setStyleSheet("color: #888; font-size:12px; padding:4px;")
 
         # --- Buttons ---
         self.btn_scan       = QPushButton("🔍 Scan BLE Sensors")
@@ -76,8 +87,8 @@ class TorqueDashboard(QMainWindow):
         self.btn_history    = QPushButton("📊 View History")
         self.btn_theme      = QPushButton("🌙 Toggle Theme")
 
-        self.btn_scan.clicked.connect(self._start_thread(self.scan_ble_devices))
-        self.btn_connect.clicked.connect(self._start_thread(self.connect_to_sensor))
+        self.btn_scan.clicked.connect(self._submit(self.scan_ble_devices))
+        self.btn_connect.clicked.connect(self._submit(self.connect_to_sensor))
         self.btn_export_csv.clicked.connect(self.export_csv)
         self.btn_export_pdf.clicked.connect(self.export_pdf)
         self.btn_history.clicked.connect(self.plot_history)
@@ -87,6 +98,7 @@ class TorqueDashboard(QMainWindow):
         main_vbox = QVBoxLayout()
         main_vbox.addLayout(top_hbox)
         main_vbox.addWidget(self.graph)
+        main_vbox.addWidget(self.stats_label)
         main_vbox.addWidget(self.threshold_label)
         main_vbox.addWidget(self.slider)
         for w in (self.btn_scan, self.btn_connect,
@@ -108,11 +120,13 @@ class TorqueDashboard(QMainWindow):
         self.timer.timeout.connect(self.update_graph)
         self.timer.start(1000)
 
-    def _start_thread(self, coro_fn):
-        """Run an async method in a daemon thread."""
-        def wrapper():
-            asyncio.run(coro_fn())
-        return lambda: threading.Thread(target=wrapper, daemon=True).start()
+    def _submit(self, coro_fn):
+        """Click handler running an async method on the shared BLE loop, once at a time."""
+        def start():
+            task = self._tasks.get(coro_fn.__name__)
+            if task is None or task.done():
+                self._tasks[coro_fn.__name__] = ble_loop.submit(coro_fn())
+        return start
 
     async def scan_ble_devices(self):
         """Scan for devices with the required service UUID."""
@@ -167,12 +181,14 @@ class TorqueDashboard(QMainWindow):
                 return
 
             self.status_label.setText("Status: Connected ✓")
+            offset, scale = torque_store.load_calibration().current(torque_store.DEFAULT_SENSOR)
             while client.is_connected:
                 try:
-                    raw = await client.read_gatt_char(TORQUE_UUID)
-                    val = int.from_bytes(raw, byteorder="little", signed=False)
-                    self.torque_label.setText(f"Torque: {val} N·cm")
-                    self._save(val)
+                    data = await client.read_gatt_char(TORQUE_UUID)
+                    # 24-bit signed ADC count; stored raw, calibrated for display
+                    raw = int.from_bytes(data[:3], byteorder="little", signed=True)
+                    self.torque_label.setText(f"Torque: {(raw - offset) * scale:.2f} N·cm")
+                    self._save(raw)
                 except Exception as e:
                     self.status_label.setText(f"Status: Read error: {str(e)}")
                     await asyncio.sleep(1.0)
@@ -188,27 +204,30 @@ class TorqueDashboard(QMainWindow):
                 self.status_label.setText("Status: Disconnected")
 
     def update_graph(self):
-        """Refresh the plot based on the last 50 records."""
-        df = pd.read_sql(
-            "SELECT * FROM torque_data ORDER BY timestamp DESC LIMIT 50",
-            sqlite3.connect(DB_FILE)
-        )
-        if df.empty:
+        """
+        Append the samples stored since the last tick to the live ring and
+        redraw it. Both the read (a primary-key seek past last_id) and the
+        redraw are bounded by LIVE_POINTS, so the cost stays flat as the
+        table grows over a multi-day session.
+        """
+        ids, ts, vals = torque_store.newer_than(self.last_id, LIVE_POINTS)
+        if len(ids):
+            self.last_id = int(ids[-1])
+            self.live.extend(ts, vals)
+        if not len(self.live):
             return
+        ts, vals = self.live.since()
 
-        times = []
-        for ts in df["timestamp"]:
-            try:
-                times.append(float(ts))
-            except:
-                times.append(pd.to_datetime(ts).timestamp())
-        times = np.array(times)
-        vals = df["torque_value"].to_numpy()
-
+        # DateAxisItem wants epoch seconds
         latest = vals[-1]
-        pen = pg.mkPen("green" if latest < self.slider.value() else "red", width=2)
-        self.graph.clear()
-        self.graph.plot(x=times, y=vals, pen=pen)
+        self.curve.setData(x=ts / 1e6, y=vals)
+        self.curve.setPen(pg.mkPen("green" if latest < self.slider.value() else "red", width=2))
+
+        s = stats.describe(vals)
+        self.stats_label.setText(
+            f"Window: mean {s['mean']:.2f} · RMS {s['rms']:.2f} · "
+            f"min {s['min']:.2f} · max {s['max']:.2f} · p2p {s['p2p']:.2f} N·cm"
+        )
 
         # keep torque label color in sync
         if latest > self.slider.value():
@@ -221,55 +240,71 @@ class TorqueDashboard(QMainWindow):
         self.threshold_label.setText(f"Alert Threshold: {v} N·cm")
 
     def export_csv(self):
-        df = pd.read_sql("SELECT * FROM torque_data", sqlite3.connect(DB_FILE))
-        df.to_csv("torque_data.csv", index=False)
+        with open("torque_data.csv", "w", newline="") as f:
+            for chunk in exporters.csv_chunks():
+                f.write(chunk)
         self.status_label.setText("Status: CSV exported")
 
     def export_pdf(self):
-        c = canvas.Canvas("torque_data.pdf")
-        c.drawString(100, 750, "Torque Sensor Report")
-        df = pd.read_sql("SELECT * FROM torque_data", sqlite3.connect(DB_FILE))
-        y = 720
-        for _, r in df.iterrows():
-            c.drawString(100, y, f"{r['timestamp']} – {r['torque_value']} N·cm")
-            y -= 20
-            if y < 50:
-                c.showPage()
-                y = 750
-        c.save()
+        report = exporters.pdf_report()
+        if report is None:
+            self.status_label.setText("Status: No data")
+            return
+        with open("torque_data.pdf", "wb") as f:
+            f.write(report.getvalue())
         self.status_label.setText("Status: PDF exported")
 
     def plot_history(self):
-        df = pd.read_sql(
-            "SELECT * FROM torque_data ORDER BY timestamp",
-            sqlite3.connect(DB_FILE)
-        )
-        if df.empty:
+        """
+        Whole-history plot. Every pan / zoom refetches only the visible range
+        at HISTORY_POINTS resolution, the way /series does: raw samples when
+        they fit, otherwise torque_store.overview() buckets. Nothing is loaded in full.
+        """
+        bounds = torque_store.time_bounds()
+        if bounds is None:
             self.status_label.setText("Status: No data")
             return
-
-        xt = pd.to_datetime(df["timestamp"])
-        plt.figure(figsize=(8, 5))
-        plt.plot(xt, df["torque_value"], marker="o")
-        plt.xlabel("Time")
-        plt.ylabel("Torque (N·cm)")
-        plt.title("Torque History")
-        plt.xticks(rotation=45)
-        plt.tight_layout()
-        plt.show()
-
-    def _save(self, val):
-        """Insert into SQLite, guarding against overflow."""
-        if not (-(2**63) <= val < 2**63):
+        if self.history is None:
+            self.history = pg.PlotWidget(axisItems={"bottom": DateAxisItem(orientation="bottom")})
+            self.history.setWindowTitle("Torque History")
+            self.history.setLabel("left", "Torque (N·cm)")
+            self.history_curve = self.history.plot(pen=pg.mkPen("#00CC66", width=1))
+            self.history_band = [self.history.plot(pen=pg.mkPen("#00CC66", width=1, style=Qt.PenStyle.DotLine))
+                                 for _ in range(2)]
+            # Refetch once the view settles, not on every intermediate range
+            self.history_timer = QTimer(singleShot=True, interval=150)
+            self.history_timer.timeout.connect(self._load_history)
+            self.history.sigXRangeChanged.connect(lambda *_: self.history_timer.start())
+            self.history.enableAutoRange(x=False)
+        self.history.setXRange(bounds[0] / 1e6, bounds[1] / 1e6, padding=0.02)
+        self.history.show()
+        self.history.raise_()
+        self._load_history()
+
+    def _load_history(self):
+        lo, hi = self.history.viewRange()[0]
+        start, end = int(lo * 1e6), int(hi * 1e6)
+        chunks = torque_store.calibrated_chunks(start, end, chunk_rows=HISTORY_POINTS + 1)
+        chunk = next(chunks, None)
+        chunks.close()
+        if chunk is None or len(chunk[0]) <= HISTORY_POINTS:
+            ts, vals = (chunk[1], chunk[3]) if chunk is not None else (np.empty(0), np.empty(0))
+            self.history_curve.setData(x=ts / 1e6, y=vals)
+            for band in self.history_band:
+                band.setData([], [])
             return
-        conn = sqlite3.connect(DB_FILE)
-        conn.execute(
-            "CREATE TABLE IF NOT EXISTS torque_data ("
-            "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP, torque_value INTEGER)"
-        )
-        conn.execute("INSERT INTO torque_data (torque_value) VALUES (?)", (val,))
-        conn.commit()
-        conn.close()
+        _, _, points = torque_store.overview(start, end, max_points=HISTORY_POINTS)
+        trend = np.array(points, dtype=np.float64)
+        if not len(trend):
+            return
+        x = trend[:, 0] / 1e6
+        self.history_curve.setData(x=x, y=trend[:, 1])
+        self.history_band[0].setData(x=x, y=trend[:, 2])
+        self.history_band[1].setData(x=x, y=trend[:, 3])
+
+    def _save(self, raw):
+        """Insert a raw ADC count into the store."""
+        torque_store.save_val(raw)
 
     def toggle_theme(self):
         if "dark" in self.styleSheet().lower():
@@ -279,6 +314,7 @@ class TorqueDashboard(QMainWindow):
 
 
 if __name__ == "__main__":
+    torque_store.init_db(offset=CONFIG.get("offset", 0.0), scale=CONFIG.get("scale", 1.0))
     app = QApplication(sys.argv)
     window = TorqueDashboard()
     window.show()